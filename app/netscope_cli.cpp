@@ -1,5 +1,12 @@
 // app/netscope_cli.cpp
+#include "netscope/anomaly.hpp"
+#include "netscope/dedup.hpp"
+#include "netscope/frag.hpp"
+#include "netscope/metrics.hpp"
 #include "netscope/parser.hpp"
+#include "netscope/pipeline.hpp"
+#include "netscope/sample.hpp"
+#include "netscope/sni.hpp"
 #include "netscope/stats.hpp"
 #include "netscope/util.hpp"
 
@@ -9,11 +16,30 @@
 #include <string>
 #include <vector>
 #include <cstdlib>   // std::strtoul
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <algorithm> // std::max
 
 using namespace netscope;
 
+static volatile std::sig_atomic_t g_interrupted = 0;
+
+static void on_interrupt(int) { g_interrupted = 1; }
+
+// --metrics: keep serving the final snapshot until Ctrl-C / SIGTERM
+static void serve_metrics_until_interrupted(const std::string& where) {
+    std::printf("\nServing final metrics on http://%s/metrics (Ctrl-C to exit)\n", where.c_str());
+    std::fflush(stdout);
+    std::signal(SIGINT, on_interrupt);
+    std::signal(SIGTERM, on_interrupt);
+    while (!g_interrupted) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    stop_metrics_server();
+}
+
 static void print_one_line(const Packet& p) {
     if (!p.valid) return;
+    if (p.tunnel_type != TUNNEL_NONE) std::printf("[%s] ", tunnel_name(p.tunnel_type));
     if (p.is_tcp) {
         bool syn = p.tcp_flags & 0x02;
         bool ack = p.tcp_flags & 0x10;
@@ -28,26 +54,187 @@ static void print_one_line(const Packet& p) {
         std::printf("UDP  ");
         print_ipv4(p.src_ip); std::printf(":%u  ->  ", p.src_port);
         print_ipv4(p.dst_ip); std::printf(":%u\n", p.dst_port);
+    } else {                 // tunnel packet without a 5-tuple (see parser.hpp)
+        std::printf("IP   ");
+        print_ipv4(p.src_ip); std::printf("  ->  ");
+        print_ipv4(p.dst_ip); std::printf("\n");
+    }
+}
+
+// Counters, timestamps and settings of one pass over the capture
+struct RunState {
+    std::size_t topN = 3;
+    std::uint32_t sampleN = 1;
+    int decapDepth = 0;
+    bool verbose = false, sni = false, detect = false, metrics = false;
+
+    int total = 0, parsed = 0, skipped = 0;
+    double first_ts = -1.0, last_ts = 0.0;   // duration tracking
+
+    std::chrono::steady_clock::time_point wall_start, last_publish;
+    std::chrono::steady_clock::duration publish_every = std::chrono::seconds(1);
+
+    // /metrics: build a snapshot and swap it in
+    void publish() {
+        const auto wall_now = std::chrono::steady_clock::now();
+        const double secs = std::chrono::duration<double>(wall_now - wall_start).count();
+        MetricsSnapshot m;
+        m.packets = (std::uint64_t)total;
+        m.parsed = (std::uint64_t)parsed;
+        m.sample_drops = (std::uint64_t)skipped;
+        m.dedup_drops = duplicates_dropped();
+        m.parse_drops = (std::uint64_t)(total - parsed - skipped) - m.dedup_drops;
+        m.total_bytes = total_bytes();
+        m.sample_rate = sampleN;
+        m.packets_per_sec = secs > 0.0 ? total / secs : 0.0;
+        m.bytes_per_sec = secs > 0.0 ? (double)m.total_bytes / secs : 0.0;
+        m.timestamp = std::chrono::duration<double>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        m.talkers = top_talkers(topN);
+        m.flows = top_flows(topN);
+        publish_metrics(std::move(m));
+        // The top-N scan is O(keys). With millions of flows a snapshot is
+        // not free, so the next one waits at least 10x as long as this one
+        // took (<= ~10% of the packet thread), and never less than 1 s.
+        last_publish = std::chrono::steady_clock::now();
+        publish_every = std::max<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(1), 10 * (last_publish - wall_now));
+    }
+};
+
+// ---- CLI-only pipeline stages ----
+
+// --verbose: one line per accounted packet
+struct PrintStage {
+    bool operator()(Frame& f) const { print_one_line(f.pkt); return true; }
+};
+
+// --verbose with --detect: print anomalies as they fire (one packet can
+// raise several, e.g. a talker and a port burst in the same bin)
+struct PrintAnomalyStage {
+    const RunState* st;
+    std::uint64_t seen = 0;
+    bool operator()(Frame&) {
+        for (; seen < anomaly_count(); ++seen) {
+            if (const Anomaly* a = anomaly_at(seen))
+                std::printf("!! %s\n", describe_anomaly(*a, st->first_ts).c_str());
+        }
+        return true;
+    }
+};
+
+// The per-packet loop for one combination of the filter/decode flags
+// (--sample, --dedup, --decap): those stages are Skip when off and vanish at
+// compile time. The rest are switched at run time (see pipeline.hpp).
+template <bool Sample, bool Dedup, bool Decap>
+static int run_loop(pcap_t* handle, RunState& st) {
+    auto pipeline = make_pipeline(
+        // with --decap the raw bytes are the OUTER tuple, so sample after parsing
+        Maybe<Sample && !Decap, SampleRawStage>{st.sampleN, &st.skipped},
+        Maybe<Dedup, DedupStage>{},
+        ParseStage{Decap ? st.decapDepth : 0},
+        FragmentStage{},
+        Maybe<Sample, SampleParsedStage<Decap>>{st.sampleN, &st.skipped},
+        optional(st.verbose, PrintStage{}),
+        AggregateStage{},
+        optional(st.sni, SniStage{}),
+        optional(st.detect, DetectStage{}),
+        optional(st.verbose && st.detect, PrintAnomalyStage{&st}));
+
+    const u_char* data = nullptr;
+    struct pcap_pkthdr* hdr = nullptr;
+    Frame f;
+    int rc = 0;
+    while ((rc = pcap_next_ex(handle, &hdr, &data)) > 0) {
+        ++st.total;
+
+        f.now = (double)hdr->ts.tv_sec + (double)hdr->ts.tv_usec / 1e6;
+        if (st.first_ts < 0.0) st.first_ts = f.now;
+        st.last_ts = f.now;
+
+        f.data = reinterpret_cast<const uint8_t*>(data);
+        f.caplen = hdr->caplen;
+        if (pipeline(f)) ++st.parsed;
+
+        // --metrics: publish about once a second (less often when snapshots
+        // are slow, see publish()). Checked after the packet is done so the
+        // counters are consistent; the wall clock is read every 4096 packets.
+        if (st.metrics && (st.total & 4095) == 0 &&
+            std::chrono::steady_clock::now() - st.last_publish >= st.publish_every)
+            st.publish();
     }
+    return rc;
 }
 
+// Turns the runtime flags into run_loop's template arguments one bool at a
+// time, so each combination (8 loops) is instantiated at build time.
+template <bool... Flags>
+struct LoopSelect {
+    static int run(pcap_t* handle, RunState& st) {
+        return run_loop<Flags...>(handle, st);
+    }
+    template <class... Rest>
+    static int run(pcap_t* handle, RunState& st, bool next, Rest... rest) {
+        return next ? LoopSelect<Flags..., true>::run(handle, st, rest...)
+                    : LoopSelect<Flags..., false>::run(handle, st, rest...);
+    }
+};
+
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::puts("Usage: netscope_cli <file.pcap> [--verbose] [--top N]");
+        std::puts("Usage: netscope_cli <file.pcap> [--verbose] [--top N] [--sample 1/N] [--decap D] [--sni] [--detect] [--metrics [HOST:]PORT] [--dedup] [--dedup-window MS]");
         return 1;
     }
 
     const char* path = argv[1];
     bool verbose = false;
     std::size_t topN = 3;
+    std::uint32_t sampleN = 1;   // 1 = every flow
+    int decapDepth = 0;          // 0 = account tunnels as their outer flow
+    bool sni = false;            // label flows from TLS/QUIC ClientHello SNI
+    bool detect = false;         // streaming burst / new-heavy / fan-out detector
+    bool dedup = false;          // drop mirror-port duplicates before aggregation
+    double dedupWindowMs = 5.0;
+    std::string metricsHost = "127.0.0.1";
+    std::uint16_t metricsPort = 0;  // 0 = no /metrics endpoint
 
     // very simple arg parse
     for (int i = 2; i < argc; ++i) {
         if (std::strcmp(argv[i], "--verbose") == 0) verbose = true;
+        else if (std::strcmp(argv[i], "--sni") == 0) sni = true;
+        else if (std::strcmp(argv[i], "--detect") == 0) detect = true;
+        else if (std::strcmp(argv[i], "--dedup") == 0) dedup = true;
+        else if (std::strcmp(argv[i], "--dedup-window") == 0 && i+1 < argc) {
+            dedup = true;
+            dedupWindowMs = std::strtod(argv[++i], nullptr);
+            if (dedupWindowMs <= 0.0) dedupWindowMs = 5.0;
+        }
         else if (std::strcmp(argv[i], "--top") == 0 && i+1 < argc) {
             topN = (std::size_t)std::strtoul(argv[++i], nullptr, 10);
             if (topN == 0) topN = 3;
         }
+        else if (std::strcmp(argv[i], "--sample") == 0 && i+1 < argc) {
+            sampleN = parse_sample_rate(argv[++i]);
+            if (sampleN == 0) {
+                std::fprintf(stderr, "--sample expects 1/N (e.g. 1/16), got '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--metrics") == 0 && i+1 < argc) {
+            const std::string spec = argv[++i];
+            const std::size_t colon = spec.rfind(':');
+            if (colon != std::string::npos) metricsHost = spec.substr(0, colon);
+            const unsigned long port = std::strtoul(spec.c_str() + (colon == std::string::npos ? 0 : colon + 1), nullptr, 10);
+            if (port == 0 || port > 65535) {
+                std::fprintf(stderr, "--metrics expects [HOST:]PORT, got '%s'\n", spec.c_str());
+                return 1;
+            }
+            metricsPort = (std::uint16_t)port;
+        }
+        else if (std::strcmp(argv[i], "--decap") == 0 && i+1 < argc) {
+            decapDepth = (int)std::strtoul(argv[++i], nullptr, 10);
+            if (decapDepth > 8) decapDepth = 8;
+        }
     }
 
     char err[PCAP_ERRBUF_SIZE] = {0};
@@ -58,38 +245,79 @@ int main(int argc, char** argv) {
     }
 
     reset_stats();
+    reset_frags();
+    reset_labels();
+    reset_anomalies();
+    reset_dedup(dedupWindowMs / 1000.0);
 
-    const u_char* data = nullptr;
-    struct pcap_pkthdr* hdr = nullptr;
-    int rc = 0, total = 0, parsed = 0;
-
-    // duration tracking
-    double first_ts = -1.0, last_ts = 0.0;
+    RunState st;
+    st.topN = topN;
+    st.sampleN = sampleN;
+    st.decapDepth = decapDepth;
+    st.verbose = verbose;
+    st.sni = sni;
+    st.detect = detect;
+    st.metrics = metricsPort != 0;
+    st.wall_start = st.last_publish = std::chrono::steady_clock::now();
 
-    while ((rc = pcap_next_ex(handle, &hdr, &data)) > 0) {
-        ++total;
-
-        double now = (double)hdr->ts.tv_sec + (double)hdr->ts.tv_usec / 1e6;
-        if (first_ts < 0.0) first_ts = now;
-        last_ts = now;
-
-        Packet p;
-        if (parse_packet(reinterpret_cast<const uint8_t*>(data), hdr->caplen, p) && p.valid) {
-            ++parsed;
-            if (verbose) print_one_line(p);
-            on_packet(p);
+    if (metricsPort != 0) {
+        std::string merr;
+        if (!start_metrics_server(metricsHost, metricsPort, merr)) {
+            std::fprintf(stderr, "metrics server on %s:%u failed: %s\n",
+                         metricsHost.c_str(), metricsPort, merr.c_str());
+            pcap_close(handle);
+            return 1;
         }
     }
+
+    // one pre-instantiated loop per filter/decode combination (see LoopSelect)
+    const int rc = LoopSelect<>::run(handle, st, sampleN > 1, dedup, decapDepth > 0);
     if (rc == -1) {
         std::fprintf(stderr, "pcap_next_ex error: %s\n", pcap_geterr(handle));
     }
     pcap_close(handle);
+    if (metricsPort != 0) st.publish();
+    const std::string metricsWhere = metricsHost + ":" + std::to_string(metricsPort);
+
+    const int total = st.total, parsed = st.parsed, skipped = st.skipped;
+    const double first_ts = st.first_ts, last_ts = st.last_ts;
 
     const double duration = (first_ts < 0.0) ? 0.0 : (last_ts - first_ts);
-    const std::uint64_t totalBytes = total_bytes();
+    const std::uint64_t totalBytes = total_bytes();   // observed; talker percentages use this
+    const Estimate totalEst = estimate_total(sampleN);
 
-    std::printf("File: %s  Duration: %.2f s  Packets: %d  Parsed: %d  Total: %s\n",
-                path, duration, total, parsed, human_bytes(totalBytes).c_str());
+    if (sampleN > 1) {
+        std::printf("File: %s  Duration: %.2f s  Packets: %d  Skipped: %d  Parsed: %d  Total: ~%s (+/- %s)\n",
+                    path, duration, total, skipped, parsed,
+                    human_bytes(totalEst.bytes).c_str(), human_bytes(totalEst.ci95).c_str());
+        std::printf("Sampling: 1/%u of flows (5-tuple hash); byte counts scaled x%u, +/- is a 95%% CI.\n",
+                    sampleN, sampleN);
+    } else {
+        std::printf("File: %s  Duration: %.2f s  Packets: %d  Parsed: %d  Total: %s\n",
+                    path, duration, total, parsed, human_bytes(totalBytes).c_str());
+    }
+
+    if (dedup) {
+        std::printf("Duplicates dropped: %llu  (window %.1f ms)\n",
+                    (unsigned long long)duplicates_dropped(), dedupWindowMs);
+    }
+
+    const FragCounters fc = frag_counters();
+    if (fc.fragments > 0) {
+        std::printf("IP fragments: %llu  (later fragments credited to flow: %llu, first fragment not seen: %llu)\n",
+                    (unsigned long long)fc.fragments,
+                    (unsigned long long)fc.resolved,
+                    (unsigned long long)fc.unresolved);
+    }
+
+    if (sni) {
+        const LabelCounters lc = label_counters();
+        std::printf("SNI: %llu flows labeled; %llu of %llu packets inspected, %llu skipped via per-flow cache\n",
+                    (unsigned long long)lc.labeled,
+                    (unsigned long long)lc.inspected,
+                    (unsigned long long)lc.packets,
+                    (unsigned long long)lc.cached);
+    }
 
     // pull sorted rows for % printing
     auto tt = top_talkers(topN);
@@ -101,6 +329,15 @@ int main(int argc, char** argv) {
         std::puts("  (none)");
     } else {
         for (const auto& r : tt) {
+            if (sampleN > 1) {
+                const Estimate e = estimate_talker(r.key, sampleN);
+                const std::string est = "~" + human_bytes(e.bytes) + " +/- " + human_bytes(e.ci95);
+                std::printf("  %-15s  %22s  (%s)\n",
+                    r.key.c_str(),
+                    est.c_str(),
+                    percent_string(r.bytes, totalBytes).c_str());
+                continue;
+            }
             std::printf("  %-15s  %10s  (%s)\n",
                 r.key.c_str(),
                 human_bytes(r.bytes).c_str(),
@@ -108,23 +345,46 @@ int main(int argc, char** argv) {
         }
     }
 
-    // Top Flows
+    // Top Flows (a sampled flow is seen in full, so its bytes stay exact and
+    // its share is taken of the estimated total, not the observed one)
     std::puts("\nTop Flows:");
     if (tf.empty()) {
         std::puts("  (none)");
     } else {
         for (const auto& r : tf) {
             std::printf("  %-50s  %10s  (%s)\n",
-                r.key.c_str(),
+                (sni ? flow_display(r.key) : r.key).c_str(),
                 human_bytes(r.bytes).c_str(),
-                percent_string(r.bytes, totalBytes).c_str());
+                percent_string(r.bytes, totalEst.bytes).c_str());
+        }
+    }
+
+    // Tunnels (outer bytes; the inner flows above are what they carried)
+    if (decapDepth > 0) {
+        auto tun = top_tunnels(topN);
+        std::puts("\nTunnels (outer bytes):");
+        if (tun.empty()) std::puts("  (none)");
+        for (const auto& r : tun) {
+            std::printf("  %-50s  %10s\n", r.key.c_str(), human_bytes(r.bytes).c_str());
         }
     }
 
+    // Anomalies (streaming detector, newest kept)
+    if (detect) {
+        const auto events = recent_anomalies();
+        std::printf("\nAnomalies (%llu):\n", (unsigned long long)anomaly_count());
+        if (events.empty()) std::puts("  (none)");
+        if (anomaly_count() > events.size())
+            std::printf("  ... %llu earlier events not kept\n",
+                        (unsigned long long)(anomaly_count() - events.size()));
+        for (const auto& a : events) std::printf("  %s\n", describe_anomaly(a, first_ts).c_str());
+    }
+
     // -------- Verdict (very simple heuristic) --------
     std::puts("\nVerdict:");
     if (totalBytes == 0 || tt.empty()) {
         std::puts("  No TCP/UDP traffic recorded.");
+        if (metricsPort != 0) serve_metrics_until_interrupted(metricsWhere);
         return 0;
     }
 
@@ -152,5 +412,6 @@ int main(int argc, char** argv) {
         std::puts  ("  Action: Try moving closer to AP, switch band, or test ISP speed.");
     }
 
+    if (metricsPort != 0) serve_metrics_until_interrupted(metricsWhere);
     return 0;
 }
@@ -0,0 +1,55 @@
+// include/netscope/anomaly.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "netscope/packet.hpp"
+
+namespace netscope {
+
+// Streaming burst / anomaly detector.
+// Keeps an EWMA of the per-second byte rate (and its variance) for every
+// talker (source IP) and every destination port, in fixed-size
+// set-associative tables. Each packet touches a constant number of slots,
+// and memory never grows, so it can stay on for long or live captures.
+//
+// Flags, as soon as the packet that crosses the line arrives:
+//   BURST     - this second's bytes exceed mean + 4 sigma of the baseline
+//   NEW_HEAVY - a talker first seen in the last few seconds is already
+//               moving a large share of the total rate
+//   FANOUT    - a talker reached many distinct destinations within a second
+
+enum AnomalyKind : uint8_t {
+    ANOMALY_BURST = 0,
+    ANOMALY_NEW_HEAVY,
+    ANOMALY_FANOUT,
+};
+
+struct Anomaly {
+    double        ts = 0.0;        // capture time of the triggering packet
+    uint8_t       kind = ANOMALY_BURST;
+    bool          is_port = false; // key is a destination port, not a talker
+    uint8_t       ip[4]{};         // talker (when !is_port)
+    uint16_t      port = 0;        // destination port (when is_port)
+    std::uint64_t bytes = 0;       // bytes in the current 1 s bin
+    double        baseline = 0.0;  // EWMA bytes/s before this bin
+    std::uint32_t distinct = 0;    // estimated distinct destinations (FANOUT)
+};
+
+void reset_anomalies();
+void anomaly_on_packet(const Packet& pkt, double now);
+
+// Most recent events (bounded ring), oldest first, and how many fired in total.
+std::vector<Anomaly> recent_anomalies();
+std::uint64_t anomaly_count();
+
+// Event number i (0 = first since reset_anomalies), or nullptr if it has
+// not fired yet or was already overwritten in the ring. No copy; for
+// following events live as they fire.
+const Anomaly* anomaly_at(std::uint64_t i);
+
+// One line, e.g. "+12.300s  BURST      talker 10.0.0.5  3.1 MB in 1 s (baseline 120.0 KB/s)"
+std::string describe_anomaly(const Anomaly& a, double start_ts);
+
+} // namespace netscope
@@ -0,0 +1,34 @@
+// include/netscope/crypto.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace netscope {
+
+// Just enough crypto to open QUIC Initial packets (RFC 9001 section 5),
+// whose keys are derived from public values. Not for protecting anything.
+
+void sha256(const uint8_t* data, std::size_t len, uint8_t out[32]);
+void hmac_sha256(const uint8_t* key, std::size_t key_len,
+                 const uint8_t* data, std::size_t len, uint8_t out[32]);
+
+// HKDF (RFC 5869) with SHA-256, and the TLS 1.3 HKDF-Expand-Label wrapper
+// with an empty context. out_len must be <= 32.
+void hkdf_extract(const uint8_t* salt, std::size_t salt_len,
+                  const uint8_t* ikm, std::size_t ikm_len, uint8_t prk[32]);
+void hkdf_expand_label(const uint8_t secret[32], const char* label,
+                       uint8_t* out, std::size_t out_len);
+
+// AES-128 single-block encryption (used for header protection and CTR mode)
+struct Aes128 {
+    uint8_t round_keys[176];
+};
+void aes128_init(Aes128& ctx, const uint8_t key[16]);
+void aes128_encrypt_block(const Aes128& ctx, const uint8_t in[16], uint8_t out[16]);
+
+// AES-128-GCM decryption WITHOUT tag verification (CTR keystream from
+// nonce || 2). Good enough to read an Initial packet's frames.
+void aes128_gcm_decrypt_untagged(const Aes128& ctx, const uint8_t nonce[12],
+                                 const uint8_t* in, std::size_t len, uint8_t* out);
+
+} // namespace netscope
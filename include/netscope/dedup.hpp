@@ -0,0 +1,24 @@
+// include/netscope/dedup.hpp
+#pragma once
+#include <cstdint>
+
+namespace netscope {
+
+// Duplicate-packet suppression for mirror/span-port and "any" captures.
+// A packet's fingerprint is a hash of its invariant IPv4 + L4 header bytes
+// (TTL and the IP/TCP/UDP checksums masked, since a second copy may have
+// crossed a router or had offload fix them up). Fingerprints live in a
+// fixed-size, time-windowed hash table; a packet whose fingerprint was seen
+// within the window is a duplicate. Link-layer bytes are ignored so copies
+// seen on different interfaces still match.
+
+// Clear the table and set the window (seconds, e.g. 0.005).
+void reset_dedup(double window_sec);
+
+// Returns true if this frame duplicates one seen within the window; the
+// first copy is recorded and returns false. Non-IPv4 frames return false.
+bool is_duplicate(const uint8_t* data, uint32_t caplen, double now);
+
+std::uint64_t duplicates_dropped();
+
+} // namespace netscope
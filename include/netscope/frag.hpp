@@ -0,0 +1,31 @@
+// include/netscope/frag.hpp
+#pragma once
+#include <cstdint>
+#include "netscope/packet.hpp"
+
+namespace netscope {
+
+// Bounded IPv4 fragment tracker (no reassembly).
+// The first fragment of a datagram records (src, dst, IP-ID, proto) -> ports
+// in a small fixed-size, set-associative table; later fragments look the key
+// up and get the same ports, so their bytes land on the right flow.
+// Entries idle for longer than the timeout, or least-recently-used within a
+// full set, are evicted. Non-fragmented packets never touch the table.
+
+void reset_frags();
+
+// Call for every parsed packet with pkt.is_fragment set. `now` is the capture
+// timestamp in seconds. Fills pkt.src_port/dst_port for non-first fragments
+// when the first fragment was seen; otherwise ports stay 0.
+void track_fragment(Packet& pkt, double now);
+
+struct FragCounters {
+    std::uint64_t fragments = 0;   // packets with MF set or offset != 0
+    std::uint64_t resolved = 0;    // non-first fragments credited to a flow
+    std::uint64_t unresolved = 0;  // non-first fragments whose first fragment was not seen
+    std::uint64_t evicted = 0;     // live entries pushed out by a full set
+};
+
+FragCounters frag_counters();
+
+} // namespace netscope
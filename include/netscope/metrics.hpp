@@ -0,0 +1,41 @@
+// include/netscope/metrics.hpp
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "netscope/stats.hpp"
+
+namespace netscope {
+
+// Prometheus text-format /metrics endpoint.
+// The packet loop fills a MetricsSnapshot every so often and hands it over
+// with publish_metrics(); that is a pointer swap, so the loop never waits on
+// a scrape. One background thread runs a non-blocking epoll server and
+// renders whatever snapshot is current when a request comes in.
+
+struct MetricsSnapshot {
+    std::uint64_t packets = 0;        // packets read from the capture
+    std::uint64_t parsed = 0;         // packets accounted
+    std::uint64_t parse_drops = 0;    // not IPv4 TCP/UDP, truncated, ...
+    std::uint64_t sample_drops = 0;   // skipped by --sample
+    std::uint64_t dedup_drops = 0;    // duplicates dropped by --dedup
+    std::uint64_t total_bytes = 0;    // IPv4 bytes accounted (observed, not scaled)
+    std::uint32_t sample_rate = 1;    // N of --sample 1/N; bytes above and in talkers/flows are observed
+    double packets_per_sec = 0.0;     // processing throughput (wall clock)
+    double bytes_per_sec = 0.0;
+    double timestamp = 0.0;           // unix time the snapshot was taken
+    std::vector<Row> talkers;         // current top-N
+    std::vector<Row> flows;
+};
+
+std::string render_metrics(const MetricsSnapshot& s);
+
+// Start the server on host:port (e.g. "127.0.0.1", 9100). Returns false and
+// fills err if the socket can't be set up. Safe to call publish_metrics()
+// before or after.
+bool start_metrics_server(const std::string& host, std::uint16_t port, std::string& err);
+void stop_metrics_server();
+
+void publish_metrics(MetricsSnapshot snap);
+
+} // namespace netscope
@@ -4,6 +4,16 @@
 
 namespace netscope {
 
+// Encapsulation that parse_packet() recognised (outermost one, if nested)
+enum TunnelType : uint8_t {
+    TUNNEL_NONE = 0,
+    TUNNEL_GRE,
+    TUNNEL_VXLAN,
+    TUNNEL_IPIP,
+    TUNNEL_GTPU,
+    TUNNEL_6IN4,   // recognised and credited, never opened (IPv6 inside)
+};
+
 // Minimal, reusable, POD-style struct
 struct Packet {
     bool     valid = false;     // did parsing succeed?
@@ -20,11 +30,28 @@ struct Packet {
     uint8_t  src_ip[4]{};       // 4 bytes: a.b.c.d
     uint8_t  dst_ip[4]{};
     uint16_t ip_total_len = 0;  // total length (header + payload), in bytes
+    uint16_t ip_id = 0;         // identification (groups fragments of one datagram)
+    bool     is_fragment = false; // MF set or fragment offset != 0
+    uint16_t frag_offset = 0;   // in 8-byte units; non-zero => no L4 header in this packet
 
     // L4
     uint16_t src_port = 0;
     uint16_t dst_port = 0;
     uint8_t  tcp_flags = 0;     // SYN=0x02, ACK=0x10, FIN=0x01, RST=0x04 (if TCP)
+    uint32_t tcp_seq = 0;       // sequence number of the first payload byte (if TCP)
+    const uint8_t* payload = nullptr; // L4 payload inside the caller's buffer (not owned)
+    uint16_t payload_len = 0;   // captured payload bytes, Ethernet padding excluded
+
+    // Tunnel (only set when decapsulation is enabled). The IPv4/L4 fields
+    // above describe the innermost packet that parsed; when an inner packet
+    // could not be opened (IPv6, truncated, not TCP/UDP) they stay at an
+    // outer level and tunnel_type still names the outermost tunnel. For a
+    // GRE/IPIP/6in4 level there is no 5-tuple: is_tcp and is_udp stay false.
+    uint8_t  tunnel_depth = 0;  // number of tunnels opened
+    uint8_t  tunnel_type = TUNNEL_NONE; // outermost tunnel, TUNNEL_NONE = plain packet
+    uint8_t  outer_src_ip[4]{}; // outermost tunnel endpoints
+    uint8_t  outer_dst_ip[4]{};
+    uint16_t outer_total_len = 0; // outermost IPv4 total length (wire bytes)
 };
 
 } // namespace netscope
@@ -7,6 +7,18 @@ namespace netscope {
 
 // Returns true if the packet is IPv4 + (TCP or UDP) and out is filled.
 // Returns false if not parseable / not IPv4 / not TCP/UDP.
-bool parse_packet(const uint8_t* data, uint32_t caplen, Packet& out);
+// Non-first IPv4 fragments are returned valid with is_fragment set and
+// ports = 0 (their L4 header lives in the first fragment); see frag.hpp.
+//
+// decap_depth > 0 opens up to that many nested tunnels (GRE, VXLAN on
+// UDP/4789, IP-in-IP, GTP-U on UDP/2152) and reports the INNER IPv4 5-tuple;
+// the outermost endpoints and length go to the outer_* / tunnel_* fields.
+// A tunnel whose inner packet can't be parsed (incl. 6in4 and GRE carrying
+// IPv6) is reported at the deepest level that does parse instead of
+// failing; for GRE/IPIP/6in4 that level is valid with is_tcp/is_udp false
+// (IPs only), so its bytes still reach the talker and tunnel totals.
+// The walk is a single loop over the caller's buffer and never allocates.
+bool parse_packet(const uint8_t* data, uint32_t caplen, Packet& out,
+                  int decap_depth = 0);
 
 } // namespace netscope
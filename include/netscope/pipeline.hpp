@@ -0,0 +1,149 @@
+// include/netscope/pipeline.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "netscope/anomaly.hpp"
+#include "netscope/dedup.hpp"
+#include "netscope/frag.hpp"
+#include "netscope/packet.hpp"
+#include "netscope/parser.hpp"
+#include "netscope/sample.hpp"
+#include "netscope/sni.hpp"
+#include "netscope/stats.hpp"
+
+namespace netscope {
+
+// Compile-time per-packet pipeline.
+//
+// A pipeline is an ordered list of stage types. Each stage is called as
+//     bool stage(Frame& f)
+// and returns false to drop the packet (later stages are not called).
+// Pipeline<...> folds the calls into one && expression, so the compiler
+// inlines the whole chain into the caller's loop. A disabled stage is
+// replaced by Skip, which folds away completely: no flag test per packet.
+// Callers pick one of a few pre-built stage lists up front. Each compile-time
+// choice doubles the number of loops, so it is kept for the stages that
+// decide which packets reach the rest; light or output-only stages are
+// wrapped in Optional and tested per packet (a predictable branch).
+
+// One packet on its way through the stages
+struct Frame {
+    const uint8_t* data = nullptr; // raw Ethernet frame
+    uint32_t caplen = 0;
+    double   now = 0.0;            // capture timestamp (seconds)
+    Packet   pkt;                  // filled by ParseStage
+};
+
+// Stand-in for a stage that is compiled out. Accepts (and ignores) the
+// disabled stage's constructor arguments so call sites stay uniform.
+struct Skip {
+    template <class... Args>
+    constexpr explicit Skip(Args&&...) {}
+    constexpr bool operator()(Frame&) const { return true; }
+};
+
+template <bool Enabled, class Stage>
+using Maybe = std::conditional_t<Enabled, Stage, Skip>;
+
+// A stage switched on or off at run time
+template <class Stage>
+struct Optional {
+    bool  on;
+    Stage stage;
+    bool operator()(Frame& f) { return !on || stage(f); }
+};
+
+template <class Stage>
+Optional<Stage> optional(bool on, Stage stage) {
+    return Optional<Stage>{on, std::move(stage)};
+}
+
+template <class... Stages>
+class Pipeline {
+public:
+    explicit Pipeline(Stages... stages) : stages_(std::move(stages)...) {}
+
+    // true if the packet went through every stage
+    bool operator()(Frame& f) { return run(f, std::index_sequence_for<Stages...>{}); }
+
+private:
+    template <std::size_t... I>
+    bool run(Frame& f, std::index_sequence<I...>) {
+        return (std::get<I>(stages_)(f) && ...);
+    }
+
+    std::tuple<Stages...> stages_;
+};
+
+template <class... Stages>
+Pipeline<Stages...> make_pipeline(Stages... stages) {
+    return Pipeline<Stages...>(std::move(stages)...);
+}
+
+// ---- filter stages ----
+
+// --sample on raw header bytes, before parsing (see sample.hpp)
+struct SampleRawStage {
+    std::uint32_t n;
+    int* skipped;
+    bool operator()(Frame& f) const {
+        if (sample_keep(f.data, f.caplen, n)) return true;
+        ++*skipped;
+        return false;
+    }
+};
+
+// --sample after parsing: fragments always, every packet when decapsulating
+// (their flow is only known once the inner/borrowed ports are in).
+template <bool AllPackets>
+struct SampleParsedStage {
+    std::uint32_t n;
+    int* skipped;
+    bool operator()(Frame& f) const {
+        if (!AllPackets && !f.pkt.is_fragment) return true;
+        if (sample_keep(f.pkt, n)) return true;
+        ++*skipped;
+        return false;
+    }
+};
+
+// --dedup: drop copies seen within the window (see dedup.hpp)
+struct DedupStage {
+    bool operator()(Frame& f) const { return !is_duplicate(f.data, f.caplen, f.now); }
+};
+
+// ---- decode stages ----
+
+struct ParseStage {
+    int decap_depth;  // 0 = no tunnel decapsulation
+    bool operator()(Frame& f) const {
+        return parse_packet(f.data, f.caplen, f.pkt, decap_depth) && f.pkt.valid;
+    }
+};
+
+// Credits non-first IPv4 fragments to their flow (see frag.hpp)
+struct FragmentStage {
+    bool operator()(Frame& f) const {
+        if (f.pkt.is_fragment) track_fragment(f.pkt, f.now);
+        return true;
+    }
+};
+
+// ---- aggregators ----
+
+struct AggregateStage {
+    bool operator()(Frame& f) const { on_packet(f.pkt); return true; }
+};
+
+struct SniStage {
+    bool operator()(Frame& f) const { label_packet(f.pkt); return true; }
+};
+
+struct DetectStage {
+    bool operator()(Frame& f) const { anomaly_on_packet(f.pkt, f.now); return true; }
+};
+
+} // namespace netscope
@@ -0,0 +1,31 @@
+// include/netscope/sample.hpp
+#pragma once
+#include <cstdint>
+#include "netscope/packet.hpp"
+
+namespace netscope {
+
+// Deterministic flow sampling for "--sample 1/N".
+// A flow is kept iff flow_hash(5-tuple) % N == 0. The hash has no per-run
+// seed, so the same flows are chosen on every run and every packet of a
+// flow gets the same decision (whole flows are kept or dropped together).
+
+// Parse "1/N" (or just "N"). Returns N >= 1, or 0 if the text is malformed.
+std::uint32_t parse_sample_rate(const char* s);
+
+// 64-bit mix of the directional 5-tuple.
+std::uint64_t flow_hash(const uint8_t* sip, uint16_t sport,
+                        const uint8_t* dip, uint16_t dport,
+                        uint8_t proto);
+
+// Cheap check on a raw Ethernet frame, done BEFORE parse_packet/on_packet.
+// Reads only the IPv4/L4 bytes the hash needs. Frames it cannot classify
+// return true, so the regular parser decides what to do with them.
+// IPv4 fragments are also passed through: their ports are only known after
+// track_fragment(), so decide those with the Packet overload below.
+bool sample_keep(const uint8_t* data, uint32_t caplen, std::uint32_t n);
+
+// Same decision from an already-parsed packet.
+bool sample_keep(const Packet& pkt, std::uint32_t n);
+
+} // namespace netscope
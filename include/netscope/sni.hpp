@@ -0,0 +1,41 @@
+// include/netscope/sni.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "netscope/packet.hpp"
+
+namespace netscope {
+
+// Flow labeling from the server name the client asks for, without DNS:
+// the SNI of a TLS ClientHello (TCP) or of a QUIC v1 Initial packet (UDP;
+// its keys are derived from the public Destination Connection ID).
+//
+// Only the first few payload packets of each new flow are inspected; a TCP
+// ClientHello spread over several segments is reassembled first. Once a
+// flow is labeled (or given up on) its state is cached, so later packets
+// cost one hash lookup and skip payload inspection entirely.
+
+// Parsers (exposed for decode_one-style experiments). Return true and fill
+// `out` when a server name was found. Truncated input just returns false.
+bool extract_tls_sni(const uint8_t* payload, std::size_t len, std::string& out);
+bool extract_quic_sni(const uint8_t* payload, std::size_t len, std::string& out);
+
+void reset_labels();
+void label_packet(const Packet& pkt);
+
+// Flow key (as used by stats) with the server's name inserted after the
+// server IP, e.g. "10.0.0.2:51000 -> 142.250.1.1 (www.google.com):443 TCP".
+// Returns the key unchanged when the flow has no label.
+std::string flow_display(const std::string& flow_key);
+
+struct LabelCounters {
+    std::uint64_t packets = 0;    // packets offered to label_packet()
+    std::uint64_t cached = 0;     // packets of already-settled flows (no inspection)
+    std::uint64_t inspected = 0;  // payloads actually parsed
+    std::uint64_t labeled = 0;    // flows that got a name
+};
+
+LabelCounters label_counters();
+
+} // namespace netscope
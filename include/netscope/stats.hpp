@@ -23,5 +23,18 @@ struct Row {
 std::uint64_t total_bytes();                             // sum of all IPv4 bytes seen
 std::vector<Row> top_talkers(std::size_t topN = 5);     // sorted desc
 std::vector<Row> top_flows(std::size_t topN = 5);       // sorted desc
+std::vector<Row> top_tunnels(std::size_t topN = 5);     // outer bytes per tunnel, sorted desc
+
+// Sampling estimates (see sample.hpp). With flows kept at rate 1/scale the
+// observed bytes are scaled by `scale`; ci95 is the ~95% half-width
+// (1.96 * sqrt(var)), treating each flow as one sampling unit.
+// scale == 1 gives exact counts and ci95 == 0.
+struct Estimate {
+    std::uint64_t bytes;
+    std::uint64_t ci95;
+};
+
+Estimate estimate_total(std::uint32_t scale);
+Estimate estimate_talker(const std::string& ip, std::uint32_t scale);
 
 } // namespace netscope
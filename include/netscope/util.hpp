@@ -11,6 +11,9 @@ std::string human_bytes(uint64_t b);
 std::string flow_key(const uint8_t* sip, uint16_t sport,
                      const uint8_t* dip, uint16_t dport,
                      uint8_t proto);
+// "GRE", "VXLAN", "IPIP", "GTP-U" (TunnelType from packet.hpp)
+const char* tunnel_name(uint8_t type);
+std::string tunnel_key(uint8_t type, const uint8_t* outer_sip, const uint8_t* outer_dip);
 // optional: small MAC printer for the demo
 void print_mac(const uint8_t* p);
 
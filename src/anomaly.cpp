@@ -0,0 +1,217 @@
+// src/anomaly.cpp
+#include "netscope/anomaly.hpp"
+#include "netscope/util.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    constexpr double kBinSec = 1.0;           // rate interval
+    constexpr double kAlpha = 0.3;            // EWMA weight of the newest bin
+    constexpr double kSigmas = 4.0;           // burst threshold above the mean...
+    constexpr double kBurstRatio = 2.0;       // ...and at least this multiple of it
+    constexpr std::uint64_t kMinBurst = 256 * 1024; // ignore "bursts" smaller than this per bin
+    constexpr int kWarmupBins = 3;            // bins before a baseline is trusted
+    constexpr double kHeavyShare = 0.30;      // NEW_HEAVY: share of the global rate
+    constexpr std::uint32_t kFanout = 32;     // FANOUT: distinct destinations per bin
+    constexpr int kMaxCatchup = 32;           // idle bins folded into the EWMA, at most
+
+    constexpr std::size_t kWays = 4;
+    constexpr std::size_t kTalkerSets = 1024; // 4096 talkers
+    constexpr std::size_t kPortSets = 256;    // 1024 ports
+    constexpr std::size_t kMaxEvents = 256;
+
+    struct Entry {
+        std::uint32_t key = 0;
+        bool          used = false;
+        std::uint8_t  bins_seen = 0;    // saturates; < kWarmupBins => still warming up
+        bool          flagged = false;  // already reported something in this bin
+        bool          heavy = false;    // NEW_HEAVY already reported for this talker
+        double        bin_start = 0.0;
+        std::uint64_t bin_bytes = 0;
+        double        mean = 0.0;       // EWMA bytes/s
+        double        var = 0.0;        // EWMA variance of bytes/s
+        std::uint64_t dst_bits = 0;     // distinct-destination bitmap for this bin
+    };
+
+    Entry g_talkers[kTalkerSets][kWays];
+    Entry g_ports[kPortSets][kWays];
+    Entry g_global;                     // all traffic, for NEW_HEAVY shares
+
+    netscope::Anomaly g_events[kMaxEvents];
+    std::uint64_t g_event_count = 0;
+
+    std::uint32_t mix32(std::uint32_t x) {
+        x ^= x >> 16; x *= 0x7FEB352Du;
+        x ^= x >> 15; x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Fold one finished bin (rate r) into the EWMA baseline
+    void fold(Entry& e, double r) {
+        const double diff = r - e.mean;
+        e.mean += kAlpha * diff;
+        e.var = (1.0 - kAlpha) * (e.var + kAlpha * diff * diff);
+        if (e.bins_seen < 255) ++e.bins_seen;
+    }
+
+    // Move e's bin forward to the one containing `now`, folding finished bins
+    void advance(Entry& e, double now) {
+        if (now < e.bin_start + kBinSec) return;
+        fold(e, (double)e.bin_bytes / kBinSec);
+        const double idle = std::floor((now - e.bin_start) / kBinSec) - 1.0;
+        for (int i = 0; i < idle && i < kMaxCatchup; ++i) fold(e, 0.0);
+        e.bin_start += kBinSec * (idle + 1.0);
+        e.bin_bytes = 0;
+        e.dst_bits = 0;
+        e.flagged = false;
+    }
+
+    // Set-associative lookup; a miss takes a free way or evicts the one
+    // that has been idle longest
+    Entry& slot(Entry* set, std::uint32_t key, double now) {
+        Entry* victim = nullptr;
+        for (std::size_t i = 0; i < kWays; ++i) {
+            if (set[i].used && set[i].key == key) return set[i];
+            if (!set[i].used) { if (!victim || victim->used) victim = &set[i]; }
+            else if (!victim || (victim->used && set[i].bin_start < victim->bin_start)) victim = &set[i];
+        }
+        *victim = Entry{};
+        victim->used = true;
+        victim->key = key;
+        victim->bin_start = now;
+        return *victim;
+    }
+
+    void emit(const netscope::Anomaly& a) {
+        g_events[g_event_count % kMaxEvents] = a;
+        ++g_event_count;
+    }
+
+    netscope::Anomaly make_event(double now, std::uint8_t kind, bool is_port,
+                                 std::uint32_t key, const Entry& e) {
+        netscope::Anomaly a;
+        a.ts = now;
+        a.kind = kind;
+        a.is_port = is_port;
+        if (is_port) a.port = (std::uint16_t)key;
+        else {
+            a.ip[0] = (std::uint8_t)(key >> 24); a.ip[1] = (std::uint8_t)(key >> 16);
+            a.ip[2] = (std::uint8_t)(key >> 8);  a.ip[3] = (std::uint8_t)key;
+        }
+        a.bytes = e.bin_bytes;
+        a.baseline = e.mean;
+        return a;
+    }
+
+    // Burst check on the running bin; shared by talkers and ports
+    void check_burst(Entry& e, double now, bool is_port) {
+        if (e.flagged || e.bins_seen < kWarmupBins || e.bin_bytes < kMinBurst) return;
+        const double limit = std::fmax(e.mean + kSigmas * std::sqrt(e.var),
+                                       e.mean * kBurstRatio) * kBinSec;
+        if ((double)e.bin_bytes > limit) {
+            emit(make_event(now, netscope::ANOMALY_BURST, is_port, e.key, e));
+            e.flagged = true;
+        }
+    }
+} // anonymous namespace
+
+namespace netscope {
+
+void reset_anomalies() {
+    for (auto& set : g_talkers) for (auto& e : set) e = Entry{};
+    for (auto& set : g_ports)   for (auto& e : set) e = Entry{};
+    g_global = Entry{};
+    g_event_count = 0;
+}
+
+void anomaly_on_packet(const Packet& pkt, double now) {
+    if (!pkt.valid || !pkt.is_ipv4 || pkt.ip_total_len == 0) return;
+    const std::uint64_t len = pkt.ip_total_len;
+
+    if (!g_global.used) { g_global.used = true; g_global.bin_start = now; }
+    advance(g_global, now);
+    g_global.bin_bytes += len;
+
+    // Talker
+    const std::uint32_t src = ((std::uint32_t)pkt.src_ip[0] << 24) | ((std::uint32_t)pkt.src_ip[1] << 16) |
+                              ((std::uint32_t)pkt.src_ip[2] << 8)  |  (std::uint32_t)pkt.src_ip[3];
+    Entry& t = slot(g_talkers[mix32(src) & (kTalkerSets - 1)], src, now);
+    advance(t, now);
+    t.bin_bytes += len;
+
+    const std::uint32_t dst = ((std::uint32_t)pkt.dst_ip[0] << 24) | ((std::uint32_t)pkt.dst_ip[1] << 16) |
+                              ((std::uint32_t)pkt.dst_ip[2] << 8)  |  (std::uint32_t)pkt.dst_ip[3];
+    const std::uint64_t bit = 1ull << (mix32(dst ^ ((std::uint32_t)pkt.dst_port << 7)) & 63);
+    const bool new_dst = (t.dst_bits & bit) == 0;
+    t.dst_bits |= bit;
+
+    check_burst(t, now, false);
+
+    if (!t.flagged && !t.heavy && t.bins_seen < kWarmupBins && g_global.bins_seen >= kWarmupBins &&
+        t.bin_bytes >= kMinBurst &&
+        (double)t.bin_bytes >= kHeavyShare * g_global.mean * kBinSec) {
+        emit(make_event(now, ANOMALY_NEW_HEAVY, false, src, t));
+        t.flagged = true;
+        t.heavy = true;
+    }
+
+    if (!t.flagged && new_dst) {
+        // linear counting over the 64-bit bitmap: n ~= -64 * ln(empty / 64)
+        const int empty = 64 - __builtin_popcountll(t.dst_bits);
+        const double est = empty == 0 ? 64.0 * std::log(64.0) : -64.0 * std::log(empty / 64.0);
+        if (est >= kFanout) {
+            Anomaly a = make_event(now, ANOMALY_FANOUT, false, src, t);
+            a.distinct = (std::uint32_t)est;
+            emit(a);
+            t.flagged = true;
+        }
+    }
+
+    // Destination port
+    if (pkt.is_tcp || pkt.is_udp) {
+        const std::uint32_t port = pkt.dst_port;
+        Entry& p = slot(g_ports[mix32(port) & (kPortSets - 1)], port, now);
+        advance(p, now);
+        p.bin_bytes += len;
+        check_burst(p, now, true);
+    }
+}
+
+std::vector<Anomaly> recent_anomalies() {
+    std::vector<Anomaly> out;
+    const std::uint64_t n = g_event_count < kMaxEvents ? g_event_count : kMaxEvents;
+    out.reserve((std::size_t)n);
+    for (std::uint64_t i = g_event_count - n; i < g_event_count; ++i)
+        out.push_back(g_events[i % kMaxEvents]);
+    return out;
+}
+
+std::uint64_t anomaly_count() {
+    return g_event_count;
+}
+
+const Anomaly* anomaly_at(std::uint64_t i) {
+    if (i >= g_event_count || g_event_count - i > kMaxEvents) return nullptr;
+    return &g_events[i % kMaxEvents];
+}
+
+std::string describe_anomaly(const Anomaly& a, double start_ts) {
+    static const char* kNames[] = {"BURST", "NEW_HEAVY", "FANOUT"};
+    const std::string who = a.is_port ? "port " + std::to_string(a.port)
+                                      : "talker " + ipv4_to_string(a.ip);
+    char buf[192];
+    if (a.kind == ANOMALY_FANOUT) {
+        std::snprintf(buf, sizeof(buf), "+%.3fs  %-9s  %-22s  ~%u destinations in 1 s",
+                      a.ts - start_ts, kNames[a.kind], who.c_str(), a.distinct);
+    } else {
+        std::snprintf(buf, sizeof(buf), "+%.3fs  %-9s  %-22s  %s in 1 s (baseline %s/s)",
+                      a.ts - start_ts, kNames[a.kind], who.c_str(),
+                      human_bytes(a.bytes).c_str(), human_bytes((std::uint64_t)a.baseline).c_str());
+    }
+    return std::string(buf);
+}
+
+} // namespace netscope
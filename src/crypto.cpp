@@ -0,0 +1,207 @@
+// src/crypto.cpp
+#include "netscope/crypto.hpp"
+#include <cstring> // std::memcpy, std::strlen
+
+namespace {
+
+// ---- SHA-256 (FIPS 180-4) ----
+const std::uint32_t K256[64] = {
+    0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+    0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+    0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+    0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+    0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+    0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+    0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+    0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2,
+};
+
+std::uint32_t rotr(std::uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+struct Sha256 {
+    std::uint32_t h[8] = {0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,
+                          0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19};
+    uint8_t buf[64]{};
+    std::size_t buf_len = 0;
+    std::uint64_t total = 0;
+
+    void block(const uint8_t* p) {
+        std::uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = ((std::uint32_t)p[4*i] << 24) | ((std::uint32_t)p[4*i+1] << 16) |
+                   ((std::uint32_t)p[4*i+2] << 8) | p[4*i+3];
+        for (int i = 16; i < 64; ++i) {
+            std::uint32_t s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+            std::uint32_t s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+        std::uint32_t a=h[0],b=h[1],c=h[2],d=h[3],e=h[4],f=h[5],g=h[6],k=h[7];
+        for (int i = 0; i < 64; ++i) {
+            std::uint32_t t1 = k + (rotr(e,6) ^ rotr(e,11) ^ rotr(e,25)) + ((e & f) ^ (~e & g)) + K256[i] + w[i];
+            std::uint32_t t2 = (rotr(a,2) ^ rotr(a,13) ^ rotr(a,22)) + ((a & b) ^ (a & c) ^ (b & c));
+            k = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0]+=a; h[1]+=b; h[2]+=c; h[3]+=d; h[4]+=e; h[5]+=f; h[6]+=g; h[7]+=k;
+    }
+
+    void update(const uint8_t* p, std::size_t n) {
+        total += n;
+        while (n > 0) {
+            std::size_t take = 64 - buf_len;
+            if (take > n) take = n;
+            std::memcpy(buf + buf_len, p, take);
+            buf_len += take; p += take; n -= take;
+            if (buf_len == 64) { block(buf); buf_len = 0; }
+        }
+    }
+
+    void finish(uint8_t out[32]) {
+        const std::uint64_t bits = total * 8;
+        const uint8_t pad = 0x80, zero = 0;
+        update(&pad, 1);
+        while (buf_len != 56) update(&zero, 1);
+        uint8_t len[8];
+        for (int i = 0; i < 8; ++i) len[i] = (uint8_t)(bits >> (56 - 8*i));
+        update(len, 8);
+        for (int i = 0; i < 8; ++i) {
+            out[4*i] = (uint8_t)(h[i] >> 24); out[4*i+1] = (uint8_t)(h[i] >> 16);
+            out[4*i+2] = (uint8_t)(h[i] >> 8); out[4*i+3] = (uint8_t)h[i];
+        }
+    }
+};
+
+// ---- AES-128 (FIPS 197), encryption only ----
+const uint8_t SBOX[256] = {
+    0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
+    0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+    0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
+    0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+    0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,
+    0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+    0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,
+    0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+    0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,
+    0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+    0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,
+    0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+    0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,
+    0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+    0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
+    0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16,
+};
+
+uint8_t xtime(uint8_t x) { return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00)); }
+
+} // anonymous namespace
+
+namespace netscope {
+
+void sha256(const uint8_t* data, std::size_t len, uint8_t out[32]) {
+    Sha256 s;
+    s.update(data, len);
+    s.finish(out);
+}
+
+void hmac_sha256(const uint8_t* key, std::size_t key_len,
+                 const uint8_t* data, std::size_t len, uint8_t out[32]) {
+    uint8_t k[64]{};
+    if (key_len > 64) sha256(key, key_len, k);
+    else std::memcpy(k, key, key_len);
+
+    uint8_t ipad[64], opad[64];
+    for (int i = 0; i < 64; ++i) { ipad[i] = k[i] ^ 0x36; opad[i] = k[i] ^ 0x5c; }
+
+    uint8_t inner[32];
+    Sha256 a; a.update(ipad, 64); a.update(data, len); a.finish(inner);
+    Sha256 b; b.update(opad, 64); b.update(inner, 32); b.finish(out);
+}
+
+void hkdf_extract(const uint8_t* salt, std::size_t salt_len,
+                  const uint8_t* ikm, std::size_t ikm_len, uint8_t prk[32]) {
+    hmac_sha256(salt, salt_len, ikm, ikm_len, prk);
+}
+
+void hkdf_expand_label(const uint8_t secret[32], const char* label,
+                       uint8_t* out, std::size_t out_len) {
+    // HkdfLabel = length(2) || len("tls13 " + label)(1) || "tls13 " + label || context len(1)=0
+    // then a single HKDF-Expand block: T(1) = HMAC(secret, info || 0x01)
+    uint8_t info[2 + 1 + 255 + 1 + 1];
+    const std::size_t llen = std::strlen(label);
+    std::size_t n = 0;
+    info[n++] = (uint8_t)(out_len >> 8);
+    info[n++] = (uint8_t)out_len;
+    info[n++] = (uint8_t)(6 + llen);
+    std::memcpy(info + n, "tls13 ", 6); n += 6;
+    std::memcpy(info + n, label, llen); n += llen;
+    info[n++] = 0;      // empty context
+    info[n++] = 0x01;   // block counter
+
+    uint8_t t[32];
+    hmac_sha256(secret, 32, info, n, t);
+    std::memcpy(out, t, out_len);
+}
+
+void aes128_init(Aes128& ctx, const uint8_t key[16]) {
+    uint8_t* rk = ctx.round_keys;
+    std::memcpy(rk, key, 16);
+    uint8_t rcon = 0x01;
+    for (int i = 16; i < 176; i += 4) {
+        uint8_t t[4] = { rk[i-4], rk[i-3], rk[i-2], rk[i-1] };
+        if (i % 16 == 0) {
+            const uint8_t first = t[0];
+            t[0] = (uint8_t)(SBOX[t[1]] ^ rcon);
+            t[1] = SBOX[t[2]];
+            t[2] = SBOX[t[3]];
+            t[3] = SBOX[first];
+            rcon = xtime(rcon);
+        }
+        for (int j = 0; j < 4; ++j) rk[i+j] = rk[i-16+j] ^ t[j];
+    }
+}
+
+void aes128_encrypt_block(const Aes128& ctx, const uint8_t in[16], uint8_t out[16]) {
+    uint8_t s[16];
+    for (int i = 0; i < 16; ++i) s[i] = in[i] ^ ctx.round_keys[i];
+
+    for (int round = 1; round <= 10; ++round) {
+        // SubBytes + ShiftRows (state is column-major: s[col*4 + row])
+        uint8_t t[16];
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                t[c*4 + r] = SBOX[s[((c + r) % 4)*4 + r]];
+
+        // MixColumns (skipped in the last round)
+        if (round != 10) {
+            for (int c = 0; c < 4; ++c) {
+                uint8_t* col = t + c*4;
+                const uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+                const uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+                col[0] ^= all ^ xtime(a0 ^ a1);
+                col[1] ^= all ^ xtime(a1 ^ a2);
+                col[2] ^= all ^ xtime(a2 ^ a3);
+                col[3] ^= all ^ xtime(a3 ^ a0);
+            }
+        }
+
+        // AddRoundKey
+        for (int i = 0; i < 16; ++i) s[i] = t[i] ^ ctx.round_keys[round*16 + i];
+    }
+    std::memcpy(out, s, 16);
+}
+
+void aes128_gcm_decrypt_untagged(const Aes128& ctx, const uint8_t nonce[12],
+                                 const uint8_t* in, std::size_t len, uint8_t* out) {
+    uint8_t ctr[16];
+    std::memcpy(ctr, nonce, 12);
+    std::uint32_t counter = 2; // J0 = nonce || 1 is reserved for the tag
+    uint8_t ks[16];
+    for (std::size_t off = 0; off < len; off += 16, ++counter) {
+        ctr[12] = (uint8_t)(counter >> 24); ctr[13] = (uint8_t)(counter >> 16);
+        ctr[14] = (uint8_t)(counter >> 8);  ctr[15] = (uint8_t)counter;
+        aes128_encrypt_block(ctx, ctr, ks);
+        const std::size_t n = (len - off < 16) ? (len - off) : 16;
+        for (std::size_t i = 0; i < n; ++i) out[off + i] = in[off + i] ^ ks[i];
+    }
+}
+
+} // namespace netscope
@@ -0,0 +1,96 @@
+// src/frag.cpp
+#include "netscope/frag.hpp"
+
+namespace {
+    constexpr std::size_t kWays = 4;          // entries per set
+    constexpr std::size_t kSets = 256;        // power of two
+    constexpr double kTimeoutSec = 30.0;      // same order as the kernel's ipfrag_time
+
+    struct Entry {
+        std::uint32_t src = 0, dst = 0;
+        std::uint16_t id = 0;
+        std::uint8_t  proto = 0;
+        bool          used = false;
+        std::uint16_t sport = 0, dport = 0;
+        double        last_seen = 0.0;
+    };
+
+    Entry g_table[kSets][kWays];              // 1024 entries, fixed
+    netscope::FragCounters g_counters;
+
+    std::uint32_t load_be32(const uint8_t* p) {
+        return ((std::uint32_t)p[0] << 24) | ((std::uint32_t)p[1] << 16) |
+               ((std::uint32_t)p[2] << 8)  |  (std::uint32_t)p[3];
+    }
+
+    std::size_t set_index(std::uint32_t src, std::uint32_t dst,
+                          std::uint16_t id, std::uint8_t proto) {
+        std::uint32_t h = src * 0x9E3779B1u ^ dst;
+        h ^= ((std::uint32_t)id << 8 | proto) * 0x85EBCA6Bu;
+        h ^= h >> 15;
+        return h & (kSets - 1);
+    }
+
+    bool same_key(const Entry& e, std::uint32_t src, std::uint32_t dst,
+                  std::uint16_t id, std::uint8_t proto) {
+        return e.used && e.src == src && e.dst == dst && e.id == id && e.proto == proto;
+    }
+} // anonymous namespace
+
+namespace netscope {
+
+void reset_frags() {
+    for (auto& set : g_table)
+        for (auto& e : set) e = Entry{};
+    g_counters = FragCounters{};
+}
+
+void track_fragment(Packet& pkt, double now) {
+    if (!pkt.is_fragment) return;
+    ++g_counters.fragments;
+
+    const std::uint32_t src = load_be32(pkt.src_ip);
+    const std::uint32_t dst = load_be32(pkt.dst_ip);
+    const std::uint8_t proto = pkt.is_tcp ? 6 : 17;
+    Entry* set = g_table[set_index(src, dst, pkt.ip_id, proto)];
+
+    if (pkt.frag_offset == 0) {
+        // First fragment: remember its ports. Reuse a matching entry, else
+        // a free/expired one, else the least-recently-used way.
+        Entry* slot = nullptr;
+        for (std::size_t i = 0; i < kWays && !slot; ++i)
+            if (same_key(set[i], src, dst, pkt.ip_id, proto)) slot = &set[i];
+        for (std::size_t i = 0; i < kWays && !slot; ++i)
+            if (!set[i].used || now - set[i].last_seen > kTimeoutSec) slot = &set[i];
+        if (!slot) {
+            slot = &set[0];
+            for (std::size_t i = 1; i < kWays; ++i)
+                if (set[i].last_seen < slot->last_seen) slot = &set[i];
+            ++g_counters.evicted;
+        }
+        slot->src = src; slot->dst = dst; slot->id = pkt.ip_id; slot->proto = proto;
+        slot->sport = pkt.src_port; slot->dport = pkt.dst_port;
+        slot->last_seen = now;
+        slot->used = true;
+        return;
+    }
+
+    // Later fragment: borrow the first fragment's ports if we still have them
+    for (std::size_t i = 0; i < kWays; ++i) {
+        Entry& e = set[i];
+        if (same_key(e, src, dst, pkt.ip_id, proto) && now - e.last_seen <= kTimeoutSec) {
+            pkt.src_port = e.sport;
+            pkt.dst_port = e.dport;
+            e.last_seen = now;
+            ++g_counters.resolved;
+            return;
+        }
+    }
+    ++g_counters.unresolved;
+}
+
+FragCounters frag_counters() {
+    return g_counters;
+}
+
+} // namespace netscope
@@ -0,0 +1,263 @@
+// src/metrics.cpp
+#include "netscope/metrics.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+    constexpr std::size_t kMaxRequest = 8192;   // drop clients that send more header than this
+
+    struct Conn {
+        std::string in;
+        std::string out;
+        std::size_t sent = 0;
+    };
+
+    // Current snapshot. The lock only guards the pointer swap/copy; rendering
+    // happens on the server thread outside it.
+    std::mutex g_snap_mu;
+    std::shared_ptr<const netscope::MetricsSnapshot> g_snap =
+        std::make_shared<netscope::MetricsSnapshot>();
+
+    std::thread g_thread;
+    int g_listen_fd = -1;
+    int g_epoll_fd = -1;
+    int g_wake_fd = -1;
+    std::atomic<bool> g_running{false};
+
+    std::shared_ptr<const netscope::MetricsSnapshot> current() {
+        std::lock_guard<std::mutex> lock(g_snap_mu);
+        return g_snap;
+    }
+
+    // Label values: escape backslash, quote and newline
+    std::string esc(const std::string& v) {
+        std::string out;
+        out.reserve(v.size());
+        for (char c : v) {
+            if (c == '\\' || c == '"') { out += '\\'; out += c; }
+            else if (c == '\n') out += "\\n";
+            else out += c;
+        }
+        return out;
+    }
+
+    void metric(std::string& out, const char* name, const char* type,
+                const char* help, const std::string& value) {
+        out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+        out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+        out += name; out += ' '; out += value; out += '\n';
+    }
+
+    std::string response(const char* status, const std::string& body) {
+        char head[192];
+        std::snprintf(head, sizeof(head),
+            "HTTP/1.1 %s\r\n"
+            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", status, body.size());
+        return head + body;
+    }
+
+    void close_conn(int fd, std::unordered_map<int, Conn>& conns) {
+        epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        conns.erase(fd);
+    }
+
+    // Returns false when the connection is finished (sent or broken)
+    bool flush(int fd, Conn& c) {
+        while (c.sent < c.out.size()) {
+            const ssize_t n = ::send(fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if (n > 0) { c.sent += (std::size_t)n; continue; }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            return false;
+        }
+        return false;
+    }
+
+    void on_readable(int fd, std::unordered_map<int, Conn>& conns) {
+        Conn& c = conns[fd];
+        char buf[2048];
+        for (;;) {
+            const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                c.in.append(buf, (std::size_t)n);
+                // checked per read: a client that never stops sending is cut
+                // off at the limit instead of when the socket drains
+                if (c.in.size() > kMaxRequest) { close_conn(fd, conns); return; }
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            close_conn(fd, conns);                       // EOF or error
+            return;
+        }
+        if (c.in.find("\r\n\r\n") == std::string::npos) return; // headers not complete yet
+
+        if (c.in.compare(0, 13, "GET /metrics ") == 0 || c.in.compare(0, 13, "GET /metrics?") == 0)
+            c.out = response("200 OK", netscope::render_metrics(*current()));
+        else
+            c.out = response("404 Not Found", "try /metrics\n");
+
+        if (flush(fd, c)) {
+            epoll_event ev{};
+            ev.events = EPOLLOUT;
+            ev.data.fd = fd;
+            epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+        } else {
+            close_conn(fd, conns);
+        }
+    }
+
+    void serve() {
+        std::unordered_map<int, Conn> conns;
+        epoll_event events[32];
+        while (g_running.load(std::memory_order_relaxed)) {
+            const int n = epoll_wait(g_epoll_fd, events, 32, -1);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                const int fd = events[i].data.fd;
+                if (fd == g_wake_fd) continue;           // stop_metrics_server()
+                if (fd == g_listen_fd) {
+                    for (;;) {
+                        const int cfd = ::accept4(g_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                        if (cfd < 0) break;
+                        epoll_event ev{};
+                        ev.events = EPOLLIN;
+                        ev.data.fd = cfd;
+                        epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, cfd, &ev);
+                        conns[cfd] = Conn{};
+                    }
+                } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    close_conn(fd, conns);
+                } else if (events[i].events & EPOLLOUT) {
+                    if (!flush(fd, conns[fd])) close_conn(fd, conns);
+                } else if (events[i].events & EPOLLIN) {
+                    on_readable(fd, conns);
+                }
+            }
+        }
+        for (auto& kv : conns) ::close(kv.first);
+    }
+} // anonymous namespace
+
+namespace netscope {
+
+std::string render_metrics(const MetricsSnapshot& s) {
+    std::string out;
+    out.reserve(1024 + 160 * (s.talkers.size() + s.flows.size()));
+
+    metric(out, "netscope_packets_total", "counter", "Packets read from the capture.",
+           std::to_string(s.packets));
+    metric(out, "netscope_packets_parsed_total", "counter", "Packets accounted (IPv4 TCP/UDP).",
+           std::to_string(s.parsed));
+
+    out += "# HELP netscope_packets_dropped_total Packets not accounted, by reason.\n";
+    out += "# TYPE netscope_packets_dropped_total counter\n";
+    out += "netscope_packets_dropped_total{reason=\"parse\"} " + std::to_string(s.parse_drops) + "\n";
+    out += "netscope_packets_dropped_total{reason=\"sample\"} " + std::to_string(s.sample_drops) + "\n";
+    out += "netscope_packets_dropped_total{reason=\"dedup\"} " + std::to_string(s.dedup_drops) + "\n";
+
+    metric(out, "netscope_bytes_total", "counter",
+           "IPv4 bytes accounted (observed; multiply by netscope_sample_rate to estimate the total).",
+           std::to_string(s.total_bytes));
+    metric(out, "netscope_sample_rate", "gauge",
+           "Flow sampling rate N of --sample 1/N (1 = every packet); byte metrics are unscaled.",
+           std::to_string(s.sample_rate));
+
+    out += "# HELP netscope_talker_bytes Bytes sent by each current top-N talker.\n";
+    out += "# TYPE netscope_talker_bytes gauge\n";
+    for (const auto& r : s.talkers)
+        out += "netscope_talker_bytes{ip=\"" + esc(r.key) + "\"} " + std::to_string(r.bytes) + "\n";
+
+    out += "# HELP netscope_flow_bytes Bytes moved by each current top-N flow.\n";
+    out += "# TYPE netscope_flow_bytes gauge\n";
+    for (const auto& r : s.flows)
+        out += "netscope_flow_bytes{flow=\"" + esc(r.key) + "\"} " + std::to_string(r.bytes) + "\n";
+
+    char num[64];
+    std::snprintf(num, sizeof(num), "%.1f", s.packets_per_sec);
+    metric(out, "netscope_processing_packets_per_second", "gauge",
+           "Packet processing throughput (wall clock).", num);
+    std::snprintf(num, sizeof(num), "%.1f", s.bytes_per_sec);
+    metric(out, "netscope_processing_bytes_per_second", "gauge",
+           "Accounted bytes processed per second (wall clock).", num);
+    std::snprintf(num, sizeof(num), "%.3f", s.timestamp);
+    metric(out, "netscope_snapshot_timestamp_seconds", "gauge",
+           "Unix time the served snapshot was taken.", num);
+    return out;
+}
+
+bool start_metrics_server(const std::string& host, std::uint16_t port, std::string& err) {
+    if (g_running.load()) { err = "metrics server already running"; return false; }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        err = "bad IPv4 address '" + host + "'";
+        return false;
+    }
+
+    g_listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (g_listen_fd < 0) { err = std::strerror(errno); return false; }
+    const int one = 1;
+    ::setsockopt(g_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(g_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(g_listen_fd, 16) < 0) {
+        err = std::strerror(errno);
+        ::close(g_listen_fd); g_listen_fd = -1;
+        return false;
+    }
+
+    g_epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    g_wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_epoll_fd < 0 || g_wake_fd < 0) {
+        err = std::strerror(errno);
+        stop_metrics_server();
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = g_listen_fd;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_listen_fd, &ev);
+    ev.data.fd = g_wake_fd;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_wake_fd, &ev);
+
+    g_running.store(true);
+    g_thread = std::thread(serve);
+    return true;
+}
+
+void stop_metrics_server() {
+    if (g_running.exchange(false)) {
+        const std::uint64_t one = 1;
+        if (::write(g_wake_fd, &one, sizeof(one)) < 0) { /* thread exits on next event anyway */ }
+        g_thread.join();
+    }
+    if (g_listen_fd >= 0) { ::close(g_listen_fd); g_listen_fd = -1; }
+    if (g_epoll_fd >= 0)  { ::close(g_epoll_fd);  g_epoll_fd = -1; }
+    if (g_wake_fd >= 0)   { ::close(g_wake_fd);   g_wake_fd = -1; }
+}
+
+void publish_metrics(MetricsSnapshot snap) {
+    auto next = std::make_shared<const MetricsSnapshot>(std::move(snap));
+    std::lock_guard<std::mutex> lock(g_snap_mu);
+    g_snap.swap(next);
+}
+
+} // namespace netscope
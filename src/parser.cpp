@@ -1,10 +1,98 @@
 // src/parser.cpp
 #include "netscope/parser.hpp"
+#include <cstddef> // std::ptrdiff_t
 #include <cstring> // std::memcpy
 
 namespace netscope {
 
-bool parse_packet(const uint8_t* data, uint32_t caplen, Packet& out) {
+namespace {
+
+uint16_t be16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+uint32_t be32(const uint8_t* p) { return ((uint32_t)be16(p) << 16) | be16(p + 2); }
+
+// Given the L4 header of an outer packet, return the start of the inner
+// IPv4 header if this is a tunnel we know how to open, else nullptr.
+// `type` is set whenever the packet is recognised as a tunnel, even one
+// that can't be opened (IPv6 payload, cut by the snaplen).
+// Only pointer arithmetic over the caller's buffer; nothing is copied.
+const uint8_t* tunnel_inner(const uint8_t* l4, const uint8_t* end,
+                            uint8_t proto, uint8_t& type) {
+    if (proto == 4) {                       // IP-in-IP: inner header follows directly
+        type = TUNNEL_IPIP;
+        return l4;
+    }
+
+    if (proto == 41) {                      // 6in4: IPv6 inside, never opened
+        type = TUNNEL_6IN4;
+        return nullptr;
+    }
+
+    if (proto == 47) {                      // GRE (RFC 2784/2890), version 0 only
+        if (end - l4 < 4) return nullptr;
+        const uint16_t flags = be16(l4);
+        if ((flags & 0x0007) != 0) return nullptr;  // version != 0 (e.g. PPTP)
+        const uint16_t ptype = be16(l4 + 2);
+        const uint8_t* p = l4 + 4;
+        if (flags & 0x8000) p += 4;         // checksum + reserved
+        if (flags & 0x2000) p += 4;         // key
+        if (flags & 0x1000) p += 4;         // sequence number
+        type = TUNNEL_GRE;
+        if (ptype == 0x0800) return p;
+        if (ptype == 0x6558) {              // transparent Ethernet bridging (NVGRE/ERSPAN-like)
+            if (end - p < 14 || be16(p + 12) != 0x0800) return nullptr;
+            return p + 14;
+        }
+        return nullptr;                     // IPv6 (0x86DD), MPLS, ...: seen, not opened
+    }
+
+    if (proto != 17 || end - l4 < 8) return nullptr;
+    const uint16_t dport = be16(l4 + 2);
+    const uint8_t* u = l4 + 8;              // UDP payload
+
+    if (dport == 4789) {                    // VXLAN: 8-byte header, then Ethernet
+        if (end - u < 8 || (u[0] & 0x08) == 0) return nullptr; // I flag
+        type = TUNNEL_VXLAN;
+        const uint8_t* eth = u + 8;
+        if (end - eth < 14 || be16(eth + 12) != 0x0800) return nullptr;
+        return eth + 14;
+    }
+
+    if (dport == 2152) {                    // GTP-U: G-PDU carrying an IP packet
+        if (end - u < 8) return nullptr;
+        const uint8_t flags = u[0];
+        if ((flags >> 5) != 1 || (flags & 0x10) == 0 || u[1] != 0xFF) return nullptr;
+        type = TUNNEL_GTPU;
+        const uint8_t* p = u + 8;
+        if (flags & 0x07) {                 // E/S/PN: seq(2) + N-PDU(1) + next ext type(1)
+            if (end - p < 4) return nullptr;
+            uint8_t next = p[3];
+            p += 4;
+            while (next != 0) {             // extension headers, length in 4-byte units
+                if (end - p < 1 || p[0] == 0 || end - p < p[0] * 4) return nullptr;
+                const uint8_t* ext = p;
+                p += ext[0] * 4;
+                next = p[-1];
+            }
+        }
+        return p;
+    }
+
+    return nullptr;
+}
+
+// True if a complete IPv4 header starts at p. Checked before descending,
+// so IPv6 inside GTP-U/GRE or an inner header cut by the snaplen leaves the
+// packet at its outer flow.
+bool ipv4_header_fits(const uint8_t* p, const uint8_t* end) {
+    if (end - p < 20 || (p[0] >> 4) != 4) return false;
+    const std::ptrdiff_t ihl = (p[0] & 0x0F) * 4;
+    return ihl >= 20 && end - p >= ihl;
+}
+
+// One walk outer -> inner. With `decap` set, tunnels are recognised at every
+// level and at most open_limit of them are opened. On failure
+// out.tunnel_depth tells how many were opened before it.
+bool walk(const uint8_t* data, uint32_t caplen, Packet& out, bool decap, int open_limit) {
     out = Packet{}; // zero/init all fields
 
     // Need Ethernet header (14 bytes)
@@ -14,53 +102,123 @@ bool parse_packet(const uint8_t* data, uint32_t caplen, Packet& out) {
     out.has_eth = true;
     std::memcpy(out.eth_dst, data + 0, 6);
     std::memcpy(out.eth_src, data + 6, 6);
-    const uint16_t eth_type = (uint16_t)((data[12] << 8) | data[13]);
+    const uint16_t eth_type = be16(data + 12);
 
     if (eth_type != 0x0800) { // 0x0800 = IPv4
         return false;         // ignore non-IPv4 for now
     }
     out.is_ipv4 = true;
 
-    // IPv4 starts at byte 14
-    if (caplen < 14 + 20) return false; // minimal IPv4 header
-    const uint8_t* ip = data + 14;
-
-    const uint8_t ver_ihl = ip[0];
-    const uint8_t version = ver_ihl >> 4;
-    const uint8_t ihl     = ver_ihl & 0x0F;  // 32-bit words
-    const uint32_t iphdr_len = ihl * 4;
-    if (version != 4 || iphdr_len < 20) return false;
-    if (caplen < 14 + iphdr_len) return false;
-
-    // total length (bytes 2..3, big-endian)
-    out.ip_total_len = (uint16_t)((ip[2] << 8) | ip[3]);
-
-    // src/dst IPv4
-    std::memcpy(out.src_ip, ip + 12, 4);
-    std::memcpy(out.dst_ip, ip + 16, 4);
-
-    const uint8_t proto = ip[9];
-    const uint8_t* l4 = ip + iphdr_len;
-
-    if (proto == 6) { // TCP
-        if (caplen < (uint32_t)(l4 - data) + 20) return false; // min TCP header
-        out.is_tcp = true;
-        out.src_port = (uint16_t)((l4[0] << 8) | l4[1]);
-        out.dst_port = (uint16_t)((l4[2] << 8) | l4[3]);
-        const uint8_t flags = l4[13];
-        out.tcp_flags = flags; // caller can check bits
-    } else if (proto == 17) { // UDP
-        if (caplen < (uint32_t)(l4 - data) + 8) return false; // min UDP header
-        out.is_udp = true;
-        out.src_port = (uint16_t)((l4[0] << 8) | l4[1]);
-        out.dst_port = (uint16_t)((l4[2] << 8) | l4[3]);
-        out.tcp_flags = 0;
-    } else {
-        return false; // ignore other protocols for now
+    const uint8_t* const end = data + caplen;
+    const uint8_t* ip = data + 14;  // IPv4 starts at byte 14
+
+    // Walk IPv4 headers outer -> inner. Each pass either descends into a
+    // tunnel (at most open_limit times) or stops at the TCP/UDP header.
+    for (;;) {
+        if (end - ip < 20) return false; // minimal IPv4 header
+
+        const uint8_t ver_ihl = ip[0];
+        const uint8_t version = ver_ihl >> 4;
+        const uint8_t ihl     = ver_ihl & 0x0F;  // 32-bit words
+        const uint32_t iphdr_len = ihl * 4;
+        if (version != 4 || iphdr_len < 20) return false;
+        if (end - ip < (std::ptrdiff_t)iphdr_len) return false;
+
+        // total length (bytes 2..3, big-endian)
+        out.ip_total_len = be16(ip + 2);
+
+        // src/dst IPv4
+        std::memcpy(out.src_ip, ip + 12, 4);
+        std::memcpy(out.dst_ip, ip + 16, 4);
+
+        // identification + flags/fragment offset (bytes 4..7)
+        out.ip_id = be16(ip + 4);
+        const uint16_t flags_off = be16(ip + 6);
+        out.frag_offset = flags_off & 0x1FFF;
+        out.is_fragment = (flags_off & 0x3FFF) != 0; // MF bit or non-zero offset
+
+        const uint8_t proto = ip[9];
+        const uint8_t* l4 = ip + iphdr_len;
+
+        // Tunnel? A fragmented outer packet can't be opened without reassembly.
+        uint8_t type = TUNNEL_NONE;
+        if (decap && !out.is_fragment) {
+            const uint8_t* inner = tunnel_inner(l4, end, proto, type);
+            if (type != TUNNEL_NONE && out.tunnel_depth == 0) { // remember the outermost endpoints
+                out.tunnel_type = type;
+                std::memcpy(out.outer_src_ip, out.src_ip, 4);
+                std::memcpy(out.outer_dst_ip, out.dst_ip, 4);
+                out.outer_total_len = out.ip_total_len;
+            }
+            if (inner && out.tunnel_depth < open_limit && ipv4_header_fits(inner, end)) {
+                ++out.tunnel_depth;
+                ip = inner;
+                continue;
+            }
+        }
+
+        // Non-first fragment: the bytes after the IP header are payload, not a
+        // TCP/UDP header. Leave ports at 0; track_fragment() fills them in.
+        if (out.frag_offset != 0) {
+            if (proto == 6)       out.is_tcp = true;
+            else if (proto == 17) out.is_udp = true;
+            else return false;
+            out.valid = true;
+            return true;
+        }
+
+        // payload ends at the IPv4 total length (drops Ethernet padding) or caplen
+        const uint8_t* ip_end = (out.ip_total_len >= iphdr_len && end - ip > out.ip_total_len)
+                                    ? ip + out.ip_total_len : end;
+
+        if (proto == 6) { // TCP
+            if (end - l4 < 20) return false; // min TCP header
+            out.is_tcp = true;
+            out.src_port = be16(l4 + 0);
+            out.dst_port = be16(l4 + 2);
+            out.tcp_seq = be32(l4 + 4);
+            const uint8_t flags = l4[13];
+            out.tcp_flags = flags; // caller can check bits
+            const uint32_t doff = (uint32_t)(l4[12] >> 4) * 4;
+            if (doff >= 20 && ip_end - l4 > (std::ptrdiff_t)doff) {
+                out.payload = l4 + doff;
+                out.payload_len = (uint16_t)(ip_end - out.payload);
+            }
+        } else if (proto == 17) { // UDP
+            if (end - l4 < 8) return false; // min UDP header
+            out.is_udp = true;
+            out.src_port = be16(l4 + 0);
+            out.dst_port = be16(l4 + 2);
+            out.tcp_flags = 0;
+            out.tcp_seq = 0;
+            if (ip_end - l4 > 8) {
+                out.payload = l4 + 8;
+                out.payload_len = (uint16_t)(ip_end - out.payload);
+            }
+        } else if (type == TUNNEL_NONE) {
+            return false; // ignore other protocols for now
+        }
+        // else: an IP-protocol tunnel (GRE, IPIP, 6in4) that was not opened.
+        // No 5-tuple, but still valid: its bytes go to the talker and tunnel.
+
+        out.valid = true;
+        return true;
     }
+}
+
+} // anonymous namespace
 
-    out.valid = true;
-    return true;
+bool parse_packet(const uint8_t* data, uint32_t caplen, Packet& out, int decap_depth) {
+    if (walk(data, caplen, out, decap_depth > 0, decap_depth)) return true;
+
+    // An opened tunnel whose inner packet does not parse (not TCP/UDP, L4
+    // header cut by the snaplen, ...): account the frame one level further
+    // out instead of dropping it. That level is a recognised tunnel, so it
+    // parses either as its UDP flow or as an IP-only tunnel packet.
+    for (int limit = out.tunnel_depth - 1; limit >= 0; limit = out.tunnel_depth - 1) {
+        if (walk(data, caplen, out, true, limit)) return true;
+    }
+    return false;
 }
 
 } // namespace netscope
@@ -0,0 +1,67 @@
+// src/sample.cpp
+#include "netscope/sample.hpp"
+#include <cstdlib> // std::strtoul
+
+namespace netscope {
+
+std::uint32_t parse_sample_rate(const char* s) {
+    if (!s || !*s) return 0;
+    char* end = nullptr;
+    unsigned long a = std::strtoul(s, &end, 10);
+    if (end == s) return 0;
+    if (*end == '\0') return (std::uint32_t)a;          // "N"
+    if (*end != '/' || a != 1) return 0;                 // only "1/N"
+    const char* d = end + 1;
+    unsigned long n = std::strtoul(d, &end, 10);
+    if (end == d || *end != '\0' || n == 0 || n > 0xFFFFFFFFul) return 0;
+    return (std::uint32_t)n;
+}
+
+std::uint64_t flow_hash(const uint8_t* sip, uint16_t sport,
+                        const uint8_t* dip, uint16_t dport,
+                        uint8_t proto) {
+    // pack the 5-tuple into two words, then a murmur3-style finalizer
+    std::uint64_t a = ((std::uint64_t)sip[0] << 56) | ((std::uint64_t)sip[1] << 48) |
+                      ((std::uint64_t)sip[2] << 40) | ((std::uint64_t)sip[3] << 32) |
+                      ((std::uint64_t)dip[0] << 24) | ((std::uint64_t)dip[1] << 16) |
+                      ((std::uint64_t)dip[2] << 8)  |  (std::uint64_t)dip[3];
+    std::uint64_t b = ((std::uint64_t)sport << 24) | ((std::uint64_t)dport << 8) | proto;
+
+    std::uint64_t h = a ^ (b * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 33; h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+bool sample_keep(const uint8_t* data, uint32_t caplen, std::uint32_t n) {
+    if (n <= 1) return true;
+
+    // Same layout checks as parse_packet, minus everything we don't hash
+    if (!data || caplen < 14 + 20) return true;
+    if (data[12] != 0x08 || data[13] != 0x00) return true; // not IPv4
+
+    const uint8_t* ip = data + 14;
+    const uint32_t iphdr_len = (uint32_t)(ip[0] & 0x0F) * 4;
+    if ((ip[0] >> 4) != 4 || iphdr_len < 20) return true;
+
+    if ((ip[6] & 0x3F) | ip[7]) return true;              // fragment: decide after parsing
+
+    const uint8_t proto = ip[9];
+    if (proto != 6 && proto != 17) return true;
+    if (caplen < 14 + iphdr_len + 4) return true;          // need both ports
+
+    const uint8_t* l4 = ip + iphdr_len;
+    const uint16_t sport = (uint16_t)((l4[0] << 8) | l4[1]);
+    const uint16_t dport = (uint16_t)((l4[2] << 8) | l4[3]);
+    return flow_hash(ip + 12, sport, ip + 16, dport, proto) % n == 0;
+}
+
+bool sample_keep(const Packet& pkt, std::uint32_t n) {
+    if (n <= 1 || !pkt.valid) return true;
+    const uint8_t proto = pkt.is_tcp ? 6 : (pkt.is_udp ? 17 : 0);
+    if (proto == 0) return true;
+    return flow_hash(pkt.src_ip, pkt.src_port, pkt.dst_ip, pkt.dst_port, proto) % n == 0;
+}
+
+} // namespace netscope
@@ -0,0 +1,286 @@
+// src/sni.cpp
+#include "netscope/sni.hpp"
+#include "netscope/crypto.hpp"
+#include "netscope/sample.hpp" // flow_hash
+#include "netscope/util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    constexpr int kMaxPayloadPkts = 3;  // payload packets inspected per flow
+    constexpr int kMaxPkts = 16;        // give up on a flow after this many packets
+    constexpr std::size_t kCryptoBuf = 4096; // QUIC CRYPTO bytes we reassemble per packet
+    constexpr std::size_t kHelloBuf = 8192;  // TLS ClientHello bytes we reassemble per TCP flow
+    constexpr std::size_t kMaxHelloFlows = 1024; // TCP flows buffered at once
+
+    struct FlowLabelState {
+        std::uint8_t seen = 0;          // packets so far
+        std::uint8_t payload_seen = 0;  // payload packets inspected so far
+        bool done = false;              // labeled or given up: skip from now on
+    };
+
+    // First bytes of a client's TLS handshake record that spans several TCP
+    // segments (large key shares, many extensions), kept in sequence order
+    // until the record is complete. Freed as soon as the flow settles.
+    struct HelloBuf {
+        std::uint32_t next_seq = 0;     // sequence number of the next byte we need
+        std::size_t want = 0;           // record length, capped at kHelloBuf
+        std::vector<std::uint8_t> bytes;
+    };
+
+    std::unordered_map<std::uint64_t, FlowLabelState> g_state;     // key: flow_hash()
+    std::unordered_map<std::uint64_t, HelloBuf> g_hello;           // key: flow_hash()
+    std::unordered_map<std::string, std::string> g_display_by_flow; // key: flow_key()
+    netscope::LabelCounters g_counters;
+
+    std::uint16_t be16(const uint8_t* p) { return (std::uint16_t)((p[0] << 8) | p[1]); }
+
+    // QUIC variable-length integer (RFC 9000 section 16)
+    bool read_varint(const uint8_t* p, std::size_t n, std::size_t& off, std::uint64_t& v) {
+        if (off >= n) return false;
+        const std::size_t len = (std::size_t)1 << (p[off] >> 6);
+        if (off + len > n) return false;
+        v = p[off] & 0x3F;
+        for (std::size_t i = 1; i < len; ++i) v = (v << 8) | p[off + i];
+        off += len;
+        return true;
+    }
+
+    bool valid_hostname(const uint8_t* p, std::size_t n) {
+        if (n == 0 || n > 253) return false;
+        for (std::size_t i = 0; i < n; ++i) {
+            const uint8_t c = p[i];
+            const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                            (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    // Handshake message starting at p (type 1 = ClientHello). Walks only the
+    // bytes we have, so a ClientHello cut short still yields an early SNI.
+    bool client_hello_sni(const uint8_t* p, std::size_t n, std::string& out) {
+        if (n < 4 || p[0] != 0x01) return false;
+        std::size_t off = 4 + 2 + 32;                    // header, legacy_version, random
+        if (off + 1 > n) return false;
+        off += 1 + p[off];                               // session id
+        if (off + 2 > n) return false;
+        off += 2 + be16(p + off);                        // cipher suites
+        if (off + 1 > n) return false;
+        off += 1 + p[off];                               // compression methods
+        if (off + 2 > n) return false;
+        off += 2;                                        // extensions length
+
+        while (off + 4 <= n) {
+            const std::uint16_t type = be16(p + off);
+            const std::uint16_t len  = be16(p + off + 2);
+            off += 4;
+            if (type == 0x0000) {                        // server_name
+                // list length(2), name type(1) = host_name, name length(2), name
+                if (off + 5 > n || p[off + 2] != 0) return false;
+                const std::size_t name_len = be16(p + off + 3);
+                if (off + 5 + name_len > n || !valid_hostname(p + off + 5, name_len)) return false;
+                out.assign(reinterpret_cast<const char*>(p + off + 5), name_len);
+                return true;
+            }
+            off += len;
+        }
+        return false;
+    }
+
+    void settle(std::uint64_t h) {
+        g_state[h].done = true;
+        g_hello.erase(h);
+    }
+
+    // TLS over TCP. A ClientHello that fits one segment is parsed in place;
+    // one that starts a longer handshake record is buffered and re-parsed as
+    // in-order segments arrive. Retransmitted bytes are skipped, and a gap
+    // (lost or reordered segment) just leaves the buffer where it is.
+    bool tcp_client_hello_sni(std::uint64_t h, const netscope::Packet& pkt, std::string& out) {
+        const uint8_t* p = pkt.payload;
+        const std::size_t n = pkt.payload_len;
+        auto it = g_hello.find(h);
+        if (it == g_hello.end()) {
+            if (netscope::extract_tls_sni(p, n, out)) return true;
+            // handshake record, ClientHello, longer than this segment
+            if (n < 6 || p[0] != 0x16 || p[1] != 0x03 || p[5] != 0x01) return false;
+            const std::size_t record = 5 + (std::size_t)be16(p + 3);
+            if (record <= n) return false;
+            if (g_hello.size() >= kMaxHelloFlows) g_hello.erase(g_hello.begin()); // stale or not, keep the bound
+            HelloBuf& b = g_hello[h];
+            b.want = std::min(record, kHelloBuf);
+            b.bytes.assign(p, p + std::min(n, b.want));
+            b.next_seq = pkt.tcp_seq + (std::uint32_t)b.bytes.size();
+            return false;
+        }
+
+        HelloBuf& b = it->second;
+        const std::uint32_t have = b.next_seq - pkt.tcp_seq; // bytes of this segment we already hold
+        if (have >= n) return false;                         // retransmit, or a gap (wraps to huge)
+        const std::size_t take = std::min(n - have, b.want - b.bytes.size());
+        b.bytes.insert(b.bytes.end(), p + have, p + have + take);
+        b.next_seq += (std::uint32_t)take;
+        const bool found = netscope::extract_tls_sni(b.bytes.data(), b.bytes.size(), out);
+        if (!found && b.bytes.size() == b.want) g_hello.erase(it); // whole record, no name
+        return found;
+    }
+
+    // flow_key() layout with " (name)" after the server's IP
+    std::string with_label(const uint8_t* sip, std::uint16_t sport,
+                           const uint8_t* dip, std::uint16_t dport, std::uint8_t proto,
+                           const std::string& name, bool server_is_dst) {
+        std::string s = netscope::ipv4_to_string(sip);
+        std::string d = netscope::ipv4_to_string(dip);
+        (server_is_dst ? d : s) += " (" + name + ")";
+        return s + ":" + std::to_string(sport) + " -> " + d + ":" + std::to_string(dport) +
+               (proto == 6 ? " TCP" : " UDP");
+    }
+} // anonymous namespace
+
+namespace netscope {
+
+bool extract_tls_sni(const uint8_t* p, std::size_t n, std::string& out) {
+    // TLS record: type 22 (handshake), version 3.x, length, then the handshake
+    if (!p || n < 5 + 4 || p[0] != 0x16 || p[1] != 0x03) return false;
+    return client_hello_sni(p + 5, n - 5, out);
+}
+
+bool extract_quic_sni(const uint8_t* p, std::size_t n, std::string& out) {
+    // Long header, fixed bit, type Initial (0), version 1
+    if (!p || n < 7 || (p[0] & 0xC0) != 0xC0 || (p[0] & 0x30) != 0) return false;
+    if (p[1] != 0 || p[2] != 0 || p[3] != 0 || p[4] != 1) return false;
+
+    std::size_t off = 5;
+    const std::size_t dcid_len = p[off++];
+    if (dcid_len > 20 || off + dcid_len >= n) return false;
+    const uint8_t* dcid = p + off;
+    off += dcid_len;
+    const std::size_t scid_len = p[off++];
+    if (scid_len > 20 || off + scid_len > n) return false;
+    off += scid_len;
+    std::uint64_t token_len = 0, length = 0;
+    if (!read_varint(p, n, off, token_len) || token_len > n - off) return false;
+    off += (std::size_t)token_len;
+    if (!read_varint(p, n, off, length)) return false;
+    const std::size_t pn_off = off;
+    if (length < 4 + 16 || length > n - pn_off) return false;
+
+    // Initial keys (RFC 9001 section 5.2)
+    static const uint8_t kSaltV1[20] = {
+        0x38,0x76,0x2c,0xf7,0xf5,0x59,0x34,0xb3,0x4d,0x17,
+        0x9a,0xe6,0xa4,0xc8,0x0c,0xad,0xcc,0xbb,0x7f,0x0a };
+    uint8_t initial[32], client[32], key[16], iv[12], hp[16];
+    hkdf_extract(kSaltV1, sizeof(kSaltV1), dcid, dcid_len, initial);
+    hkdf_expand_label(initial, "client in", client, 32);
+    hkdf_expand_label(client, "quic key", key, 16);
+    hkdf_expand_label(client, "quic iv", iv, 12);
+    hkdf_expand_label(client, "quic hp", hp, 16);
+
+    // Remove header protection: mask from a 16-byte sample 4 bytes past the PN
+    Aes128 aes;
+    aes128_init(aes, hp);
+    uint8_t mask[16];
+    aes128_encrypt_block(aes, p + pn_off + 4, mask);
+    const uint8_t first = p[0] ^ (mask[0] & 0x0F);
+    const std::size_t pn_len = (first & 0x03) + 1;
+    uint8_t nonce[12];
+    std::memcpy(nonce, iv, 12);
+    for (std::size_t i = 0; i < pn_len; ++i)
+        nonce[12 - pn_len + i] ^= p[pn_off + i] ^ mask[1 + i];
+
+    // Decrypt the frames (tag not checked; we only want to read them)
+    std::size_t ct_len = (std::size_t)length - pn_len - 16;
+    uint8_t plain[kCryptoBuf];
+    if (ct_len > sizeof(plain)) ct_len = sizeof(plain);
+    aes128_init(aes, key);
+    aes128_gcm_decrypt_untagged(aes, nonce, p + pn_off + pn_len, ct_len, plain);
+
+    // Gather CRYPTO frames (clients may split and reorder the ClientHello)
+    uint8_t crypto[kCryptoBuf];
+    bool have[kCryptoBuf] = {};
+    std::size_t f = 0;
+    while (f < ct_len) {
+        std::uint64_t type = 0;
+        if (!read_varint(plain, ct_len, f, type)) break;
+        if (type == 0x00 || type == 0x01) continue;            // PADDING, PING
+        if (type == 0x02 || type == 0x03) {                    // ACK
+            std::uint64_t v = 0, ranges = 0;
+            if (!read_varint(plain, ct_len, f, v) || !read_varint(plain, ct_len, f, v) ||
+                !read_varint(plain, ct_len, f, ranges) || !read_varint(plain, ct_len, f, v)) break;
+            bool ok = true;
+            for (std::uint64_t r = 0; r < ranges * 2 && ok; ++r) ok = read_varint(plain, ct_len, f, v);
+            for (int e = 0; type == 0x03 && e < 3 && ok; ++e) ok = read_varint(plain, ct_len, f, v);
+            if (!ok) break;
+            continue;
+        }
+        if (type != 0x06) break;                               // anything else: stop
+        std::uint64_t c_off = 0, c_len = 0;
+        if (!read_varint(plain, ct_len, f, c_off) || !read_varint(plain, ct_len, f, c_len)) break;
+        if (c_len > ct_len - f) break;
+        if (c_off < kCryptoBuf) {
+            const std::size_t take = (std::size_t)((c_off + c_len > kCryptoBuf) ? kCryptoBuf - c_off : c_len);
+            std::memcpy(crypto + c_off, plain + f, take);
+            std::memset(have + c_off, 1, take);
+        }
+        f += (std::size_t)c_len;
+    }
+
+    std::size_t contiguous = 0;
+    while (contiguous < kCryptoBuf && have[contiguous]) ++contiguous;
+    return client_hello_sni(crypto, contiguous, out);
+}
+
+void reset_labels() {
+    g_state.clear();
+    g_hello.clear();
+    g_display_by_flow.clear();
+    g_counters = LabelCounters{};
+}
+
+void label_packet(const Packet& pkt) {
+    if (!pkt.valid || (!pkt.is_tcp && !pkt.is_udp)) return;
+    ++g_counters.packets;
+
+    const std::uint8_t proto = pkt.is_tcp ? 6 : 17;
+    const std::uint64_t h = flow_hash(pkt.src_ip, pkt.src_port, pkt.dst_ip, pkt.dst_port, proto);
+    FlowLabelState& st = g_state[h];
+    if (st.done) { ++g_counters.cached; return; }   // the common case once a flow is settled
+
+    if (++st.seen >= kMaxPkts) settle(h);
+    if (pkt.payload_len == 0 || pkt.frag_offset != 0) return;
+
+    ++g_counters.inspected;
+    std::string name;
+    const bool found = pkt.is_tcp ? tcp_client_hello_sni(h, pkt, name)
+                                  : extract_quic_sni(pkt.payload, pkt.payload_len, name);
+    if (!found) {
+        // a ClientHello still being reassembled gets its remaining segments
+        if (++st.payload_seen >= kMaxPayloadPkts && !g_hello.count(h)) st.done = true;
+        if (st.done) settle(h); // also frees a buffer started on the flow's last packet
+        return;
+    }
+
+    // Client -> server direction; label the reverse (download) flow too
+    settle(h);
+    settle(flow_hash(pkt.dst_ip, pkt.dst_port, pkt.src_ip, pkt.src_port, proto));
+    g_display_by_flow[flow_key(pkt.src_ip, pkt.src_port, pkt.dst_ip, pkt.dst_port, proto)] =
+        with_label(pkt.src_ip, pkt.src_port, pkt.dst_ip, pkt.dst_port, proto, name, true);
+    g_display_by_flow[flow_key(pkt.dst_ip, pkt.dst_port, pkt.src_ip, pkt.src_port, proto)] =
+        with_label(pkt.dst_ip, pkt.dst_port, pkt.src_ip, pkt.src_port, proto, name, false);
+    ++g_counters.labeled;
+}
+
+std::string flow_display(const std::string& key) {
+    auto it = g_display_by_flow.find(key);
+    return it == g_display_by_flow.end() ? key : it->second;
+}
+
+LabelCounters label_counters() {
+    return g_counters;
+}
+
+} // namespace netscope
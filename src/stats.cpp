@@ -7,27 +7,39 @@
 #include <string>
 #include <cstdio>
 #include <cstdint>
+#include <cmath>
 
 namespace {
     // Internal counters (not exposed outside this file)
     std::unordered_map<std::string, std::uint64_t> g_bytes_by_src;   // key: "a.b.c.d"
     std::unordered_map<std::string, std::uint64_t> g_bytes_by_flow;  // key: "a.b.c.d:p -> w.x.y.z:q TCP/UDP"
+    std::unordered_map<std::string, std::uint64_t> g_bytes_by_tunnel; // key: "VXLAN a.b.c.d -> w.x.y.z" (outer bytes)
 
-    // Build a sorted vector of netscope::Row from a map, descending by bytes
+    std::uint64_t g_total_bytes = 0; // running sum of g_bytes_by_src
+
+    // Top-N rows of a map, descending by bytes (ties by key). Only the N
+    // winners are copied out, so this stays cheap on maps with millions of
+    // keys (it runs on every /metrics snapshot).
     std::vector<netscope::Row> make_sorted_rows(
         const std::unordered_map<std::string, std::uint64_t>& m,
         std::size_t topN
     ) {
+        using Entry = const std::pair<const std::string, std::uint64_t>*;
+        std::vector<Entry> entries;
+        entries.reserve(m.size());
+        for (const auto& kv : m) entries.push_back(&kv);
+
+        const std::size_t n = std::min(topN, entries.size());
+        std::partial_sort(entries.begin(), entries.begin() + n, entries.end(),
+                          [](Entry a, Entry b){
+                              if (a->second != b->second) return a->second > b->second;
+                              return a->first < b->first;
+                          });
+
         std::vector<netscope::Row> rows;
-        rows.reserve(m.size());
-        for (const auto& kv : m) {
-            rows.push_back(netscope::Row{kv.first, kv.second});
-        }
-        std::sort(rows.begin(), rows.end(),
-                  [](const netscope::Row& a, const netscope::Row& b){
-                      return a.bytes > b.bytes;
-                  });
-        if (rows.size() > topN) rows.resize(topN);
+        rows.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            rows.push_back(netscope::Row{entries[i]->first, entries[i]->second});
         return rows;
     }
 
@@ -47,6 +59,20 @@ namespace {
                         netscope::human_bytes(r.bytes).c_str());
         }
     }
+
+    // Scale an observed sum and its sum of per-flow squares.
+    // Each flow is in the sample with p = 1/scale, so the Horvitz-Thompson
+    // variance estimate is scale*(scale-1) * sum(y^2) over sampled flows.
+    netscope::Estimate scaled(std::uint64_t sum, double sumsq, std::uint32_t scale) {
+        if (scale <= 1) return netscope::Estimate{sum, 0};
+        const double var = (double)scale * (double)(scale - 1) * sumsq;
+        return netscope::Estimate{sum * scale, (std::uint64_t)(1.96 * std::sqrt(var))};
+    }
+
+    // "a.b.c.d:p -> ..." -> "a.b.c.d"
+    std::string flow_src(const std::string& key) {
+        return key.substr(0, key.find(':'));
+    }
 } // anonymous namespace
 
 namespace netscope {
@@ -54,14 +80,23 @@ namespace netscope {
 void reset_stats() {
     g_bytes_by_src.clear();
     g_bytes_by_flow.clear();
+    g_bytes_by_tunnel.clear();
+    g_total_bytes = 0;
 }
 
 void on_packet(const Packet& pkt) {
     if (!pkt.valid || !pkt.is_ipv4 || pkt.ip_total_len == 0)
         return;
 
+    // Decapsulated: keep the outer tunnel total; everything below uses the inner packet
+    if (pkt.tunnel_type != TUNNEL_NONE) {
+        g_bytes_by_tunnel[tunnel_key(pkt.tunnel_type, pkt.outer_src_ip, pkt.outer_dst_ip)]
+            += pkt.outer_total_len;
+    }
+
     // Count bytes by source IP
     g_bytes_by_src[ipv4_to_string(pkt.src_ip)] += pkt.ip_total_len;
+    g_total_bytes += pkt.ip_total_len;
 
     // Count bytes by flow (requires TCP or UDP)
     uint8_t proto = pkt.is_tcp ? 6 : (pkt.is_udp ? 17 : 0);
@@ -84,9 +119,7 @@ void print_top_flows(std::size_t topN) {
 
 // --- NEW: totals + sorted rows for CLI percentages ---
 std::uint64_t total_bytes() {
-    std::uint64_t sum = 0;
-    for (const auto& kv : g_bytes_by_src) sum += kv.second; // each byte counted once here
-    return sum;
+    return g_total_bytes; // each byte counted once (per source IP)
 }
 
 std::vector<Row> top_talkers(std::size_t topN) {
@@ -97,4 +130,25 @@ std::vector<Row> top_flows(std::size_t topN) {
     return make_sorted_rows(g_bytes_by_flow, topN);
 }
 
+std::vector<Row> top_tunnels(std::size_t topN) {
+    return make_sorted_rows(g_bytes_by_tunnel, topN);
+}
+
+Estimate estimate_total(std::uint32_t scale) {
+    double sumsq = 0.0;
+    for (const auto& kv : g_bytes_by_flow) sumsq += (double)kv.second * (double)kv.second;
+    return scaled(total_bytes(), sumsq, scale);
+}
+
+Estimate estimate_talker(const std::string& ip, std::uint32_t scale) {
+    auto it = g_bytes_by_src.find(ip);
+    if (it == g_bytes_by_src.end()) return Estimate{0, 0};
+    double sumsq = 0.0;
+    if (scale > 1) {
+        for (const auto& kv : g_bytes_by_flow)
+            if (flow_src(kv.first) == ip) sumsq += (double)kv.second * (double)kv.second;
+    }
+    return scaled(it->second, sumsq, scale);
+}
+
 } // namespace netscope
@@ -1,5 +1,6 @@
 // src/util.cpp
 #include "netscope/util.hpp"
+#include "netscope/packet.hpp"
 #include <cstdio>
 #include <cinttypes>
 
@@ -37,6 +38,26 @@ std::string flow_key(const uint8_t* sip, uint16_t sport,
     return std::string(buf);
 }
 
+const char* tunnel_name(uint8_t type) {
+    switch (type) {
+        case TUNNEL_GRE:   return "GRE";
+        case TUNNEL_VXLAN: return "VXLAN";
+        case TUNNEL_IPIP:  return "IPIP";
+        case TUNNEL_GTPU:  return "GTP-U";
+        case TUNNEL_6IN4:  return "6in4";
+        default:           return "NONE";
+    }
+}
+
+std::string tunnel_key(uint8_t type, const uint8_t* outer_sip, const uint8_t* outer_dip) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%s %u.%u.%u.%u -> %u.%u.%u.%u",
+        tunnel_name(type),
+        outer_sip[0],outer_sip[1],outer_sip[2],outer_sip[3],
+        outer_dip[0],outer_dip[1],outer_dip[2],outer_dip[3]);
+    return std::string(buf);
+}
+
 void print_mac(const uint8_t* p) {
     std::printf("%02X:%02X:%02X:%02X:%02X:%02X",
                 p[0],p[1],p[2],p[3],p[4],p[5]);